@@ -0,0 +1 @@
+python device/bench.py --file=device/disk.bin --block-num=2048 --block-len=512 --count=1024
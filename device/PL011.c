@@ -55,6 +55,10 @@ uint8_t PL011_getc( PL011_t* d            ) {
   return d->DR;
 }
 
+int     PL011_can_getc( PL011_t* d        ) {
+  return !( d->FR & 0x10 );
+}
+
 void    PL011_puth( PL011_t* d, uint8_t x ) {
   PL011_putc( d, itox( ( x >> 4 ) & 0xF ) );
   PL011_putc( d, itox( ( x >> 0 ) & 0xF ) );
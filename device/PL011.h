@@ -66,6 +66,8 @@ extern PL011_t* const UART3;
 void    PL011_putc( PL011_t* d, uint8_t x );
 // recieve  raw      byte x via PL011 instance d
 uint8_t PL011_getc( PL011_t* d            );
+// test whether PL011_getc can recieve a byte via PL011 instance d without waiting
+int     PL011_can_getc( PL011_t* d        );
 
 // transmit hexified byte x via PL011 instance d
 void    PL011_puth( PL011_t* d, uint8_t x );
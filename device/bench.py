@@ -0,0 +1,108 @@
+import argparse, operator, os, shutil, socket, struct, subprocess, sys, tempfile, time
+
+# This benchmark stands in for the kernel: it listens where QEMU would,
+# starts disk.py against a scratch copy of the disk image, then times a
+# run of block writes and reads in each encoding (hex first, since the
+# disk starts out in hex, then binary after negotiating it). The host
+# time mostly measures disk.py itself, so the bytes on the wire, and
+# hence the blocks/sec a UART at a given baud rate can sustain, is the
+# figure that matters on the board.
+
+FRAME_SOF = 0xA5
+
+def fletcher16( data ) :
+  x = bytearray( data ) ; n = len( x )
+
+  # closed form of the running sums: byte i contributes n - i times to s2
+
+  return sum( x ) % 255, sum( map( operator.mul, x, xrange( n, 0, -1 ) ) ) % 255
+
+class Disk :
+  def __init__( self, sd ) :
+    self.sd   = sd
+    self.seq  = 0
+    self.wire = 0
+
+  def hex( self, cmd, *fields ) :
+    req = '%02X' % ( cmd ) + ''.join( [ ' ' + x.encode( 'hex' ).upper() for x in fields ] ) + '\n'
+
+    self.sd.write( req ) ; self.sd.flush()
+    ack = self.sd.readline()
+
+    self.wire += len( req ) + len( ack )
+
+    ack = ack.strip().split( ' ' )
+
+    return int( ack[ 0 ], 16 ), ''.join( ack[ 1 : ] ).decode( 'hex' )
+
+  def bin( self, cmd, *fields ) :
+    self.seq  = ( self.seq + 1 ) & 0xFF
+    data = ''.join( fields )
+    head = struct.pack( '<BBL', cmd, self.seq, len( data ) )
+    req  = chr( FRAME_SOF ) + head + data + struct.pack( '<BB', *fletcher16( head + data ) )
+
+    self.sd.write( req ) ; self.sd.flush()
+
+    while ( self.sd.read( 1 ) != chr( FRAME_SOF ) ) :
+      pass
+
+    head = self.sd.read( 6 ) ; ack, seq, n = struct.unpack( '<BBL', head )
+    data = self.sd.read( n ) ; tail = self.sd.read( 2 )
+
+    self.wire += len( req ) + 1 + len( head ) + len( data ) + len( tail )
+
+    if ( seq != self.seq or fletcher16( head + data ) != struct.unpack( '<BB', tail ) ) :
+      raise IOError( 'bad acknowledgement' )
+
+    return ack, data
+
+def run( disk, name, request, count, block_len, baud ) :
+  block = os.urandom( block_len ) ; disk.wire = 0 ; t = time.time()
+
+  for i in range( count ) :
+    request( 0x01, struct.pack( '<l', i ), block )
+  for i in range( count ) :
+    request( 0x02, struct.pack( '<l', i ) )
+
+  t = time.time() - t
+
+  # a UART moves 10 bits per byte (start + 8 data + stop), which is what
+  # actually bounds throughput on the board, rather than the host time
+
+  n = disk.wire / ( 2.0 * count )
+
+  print '%-6s : %6d blocks in %6.2f s = %8.1f blocks/sec, %6.1f bytes on the wire per block = %6.1f blocks/sec at %d baud' % ( name, 2 * count, t, ( 2 * count ) / t, n, baud / ( 10 * n ), baud )
+
+if ( __name__ == '__main__' ) :
+  parser = argparse.ArgumentParser()
+
+  parser.add_argument( '--file',      type =  str, action = 'store', default = 'device/disk.bin' )
+  parser.add_argument( '--block-num', type =  int, action = 'store', default = 2048              )
+  parser.add_argument( '--block-len', type =  int, action = 'store', default =  512              )
+  parser.add_argument( '--count',     type =  int, action = 'store', default = 1024              )
+  parser.add_argument( '--baud',      type =  int, action = 'store', default = 115200            )
+
+  args = parser.parse_args()
+
+  # work on a scratch copy, so the real image is never touched
+
+  image = tempfile.mktemp( suffix = '.bin' ) ; shutil.copyfile( args.file, image )
+
+  s = socket.socket( socket.AF_INET, socket.SOCK_STREAM )
+  s.bind( ( '127.0.0.1', 0 ) ) ; s.listen( 1 )
+
+  p = subprocess.Popen( [ sys.executable, os.path.join( os.path.dirname( __file__ ), 'disk.py' ),
+                          '--host=127.0.0.1', '--port=%d' % ( s.getsockname()[ 1 ] ), '--file=' + image,
+                          '--block-num=%d' % ( args.block_num ), '--block-len=%d' % ( args.block_len ) ], stdout = open( os.devnull, 'w' ) )
+
+  c, _ = s.accept() ; c.setsockopt( socket.IPPROTO_TCP, socket.TCP_NODELAY, 1 )
+  disk = Disk( c.makefile( 'rwb' ) )
+
+  run( disk, 'hex',    disk.hex, args.count, args.block_len, args.baud )
+
+  if ( disk.hex( 0x03, chr( 0x01 ) )[ 0 ] != 0x00 ) :
+    print 'binary : not supported by disk'
+  else :
+    run( disk, 'binary', disk.bin, args.count, args.block_len, args.baud )
+
+  disk.sd.close() ; c.close() ; p.wait() ; os.remove( image )
@@ -1,5 +1,27 @@
 #include "disk.h"
 
+/* The disk speaks one of two encodings: the original hex encoding, in
+ * which each request is a line of hexified fields, or a binary framed
+ * encoding, laid out as
+ *
+ * SOF | cmd/ack | seq | length (4 bytes) | payload | checksum (2 bytes)
+ *
+ * The binary encoding halves the number of bytes on the wire for each
+ * block, so disk_init asks the disk for it; an older disk fails the
+ * request, in which case we carry on in hex.
+ */
+
+static int      disk_mode = DISK_MODE_HEX;
+static uint8_t  disk_seq  = 0;
+static uint32_t disk_blen = 512;  // block length, queried from the disk
+
+static uint8_t sum_s1, sum_s2; // running Fletcher-16 checksum
+
+static uint32_t disk_trips = 0;  // requests sent, i.e., round trips made
+
+static disk_req_t dq_pool[ DISK_QUEUE_LIMIT ]; // asynchronous requests
+static uint32_t   dq_pos = 0;                  // address last read, i.e., where the elevator is
+
 void addr_puth( PL011_t* d, uint32_t x ) {
   PL011_puth( d, ( x >>  0 ) & 0xFF );
   PL011_puth( d, ( x >>  8 ) & 0xFF );
@@ -19,67 +41,221 @@ void data_geth( PL011_t* d,       uint8_t* x, int n ) {
   }
 }
 
-uint32_t disk_get_block_num() {
-  int n = 2 * sizeof( uint32_t ); uint8_t x[ n ];
+// === BINARY FRAMES ===
 
-  for( int i = 0; i < RETRY; i++ ) {
-      PL011_puth( UART1, 0x00 );        // write command
-      PL011_putc( UART1, '\n' );        // write EOL
+void sum_put( PL011_t* d, uint8_t x ) {
+  sum_s1 = ( sum_s1 + x      ) % 255;
+  sum_s2 = ( sum_s2 + sum_s1 ) % 255;
 
-    if( PL011_geth( UART1 ) == 0x00 ) { // read  command
-      PL011_getc( UART1       );        // read  separator
-       data_geth( UART1, x, n );        // read  data
-      PL011_getc( UART1       );        // read  EOL
+  PL011_putc( d, x );
+}
+
+uint8_t sum_get( PL011_t* d ) {
+  uint8_t x = PL011_getc( d );
+
+  sum_s1 = ( sum_s1 + x      ) % 255;
+  sum_s2 = ( sum_s2 + sum_s1 ) % 255;
+
+  return x;
+}
+
+void frame_put_head( PL011_t* d, uint8_t cmd, uint32_t n ) {
+  sum_s1 = sum_s2 = 0;
+  disk_trips++;
+
+  PL011_putc( d, FRAME_SOF );
+     sum_put( d, cmd       );
+     sum_put( d, disk_seq  );
+     sum_put( d, ( n >>  0 ) & 0xFF );
+     sum_put( d, ( n >>  8 ) & 0xFF );
+     sum_put( d, ( n >> 16 ) & 0xFF );
+     sum_put( d, ( n >> 24 ) & 0xFF );
+}
+
+void frame_put_addr( PL011_t* d, uint32_t x ) {
+  sum_put( d, ( x >>  0 ) & 0xFF );
+  sum_put( d, ( x >>  8 ) & 0xFF );
+  sum_put( d, ( x >> 16 ) & 0xFF );
+  sum_put( d, ( x >> 24 ) & 0xFF );
+}
+
+void frame_put_data( PL011_t* d, const uint8_t* x, int n ) {
+  for( int i = 0; i < n; i++ ) {
+    sum_put( d, x[ i ] );
+  }
+}
+
+void frame_put_tail( PL011_t* d ) {
+  uint8_t s1 = sum_s1, s2 = sum_s2;
+
+  PL011_putc( d, s1 );
+  PL011_putc( d, s2 );
+}
+
+// read the header of the acknowledgement to the current request, returning its length
+int frame_get_head( PL011_t* d, uint8_t* ack ) {
+  while( 1 ) {
+    while( PL011_getc( d ) != FRAME_SOF ) {
+      /* skip anything up to the start of the frame */
+    }
+
+    sum_s1 = sum_s2 = 0;
+
+    uint32_t n;
+    uint8_t  seq;
+
+    *ack = sum_get( d );
+     seq = sum_get( d );
+       n = ( ( uint32_t )( sum_get( d ) ) <<  0 ) |
+           ( ( uint32_t )( sum_get( d ) ) <<  8 ) |
+           ( ( uint32_t )( sum_get( d ) ) << 16 ) |
+           ( ( uint32_t )( sum_get( d ) ) << 24 ) ;
 
-      return ( ( uint32_t )( x[ 0 ] ) <<  0 ) |
-             ( ( uint32_t )( x[ 1 ] ) <<  8 ) |
-             ( ( uint32_t )( x[ 2 ] ) << 16 ) |
-             ( ( uint32_t )( x[ 3 ] ) << 24 ) ;
-    } 
+    if( seq == disk_seq ) {
+      return ( int )( n );
+    }
+
+    for( int i = 0; i < n + 2; i++ ) {
+      PL011_getc( d );                  // stale: discard payload and checksum
+    }
+  }
+}
+
+// read m bytes of payload into x, and discard any of the n bytes received beyond that
+void frame_get_data( PL011_t* d, uint8_t* x, int m, int n ) {
+  for( int i = 0; i < n; i++ ) {
+    if( i < m ) {
+      x[ i ] = sum_get( d );
+    }
     else {
-      PL011_getc( UART1       );        // read  EOL
+               sum_get( d );
     }
   }
+}
 
-  return -1;
+// read the checksum, returning 0 iff. it matches the frame
+int frame_get_tail( PL011_t* d ) {
+  uint8_t s1 = sum_s1, s2 = sum_s2;
+
+  uint8_t t1 = PL011_getc( d );
+  uint8_t t2 = PL011_getc( d );
+
+  return ( s1 == t1 && s2 == t2 ) ? 0 : -1;
 }
 
-uint32_t disk_get_block_len() {
+// === DISK OPERATIONS ===
+
+void disk_init() {
+  disk_mode = DISK_MODE_HEX;
+
+    disk_trips++;
+    PL011_puth( UART1, 0x03 );          // write command
+    PL011_putc( UART1, ' '  );          // write separator
+    PL011_puth( UART1, DISK_MODE_BIN ); // write mode
+    PL011_putc( UART1, '\n' );          // write EOL
+
+  if( PL011_geth( UART1 ) == 0x00 ) {   // read  command
+    disk_mode = DISK_MODE_BIN;          // supported: switch to binary
+  }
+
+    PL011_getc( UART1       );          // read  EOL
+
+  uint32_t n = disk_get_block_len();
+
+  if( n != -1 ) {
+    disk_blen = n;
+  }
+}
+
+int disk_get_mode() {
+  return disk_mode;
+}
+
+uint32_t disk_get_conf( int i ) {
+  disk_drain();
+
   int n = 2 * sizeof( uint32_t ); uint8_t x[ n ];
 
-  for( int i = 0; i < RETRY; i++ ) {
-      PL011_puth( UART1, 0x00 );        // write command
-      PL011_putc( UART1, '\n' );        // write EOL
+  for( int j = 0; j < RETRY; j++ ) {
+    if( disk_mode == DISK_MODE_BIN ) {
+      uint8_t ack; int m;
 
-    if( PL011_geth( UART1 ) == 0x00 ) { // read  command
-      PL011_getc( UART1       );        // read  separator
-       data_geth( UART1, x, n );        // read  data
-      PL011_getc( UART1       );        // read  EOL
+      disk_seq++;
+      frame_put_head( UART1, 0x00, 0 );
+      frame_put_tail( UART1          );
 
-      return ( ( uint32_t )( x[ 4 ] ) <<  0 ) |
-             ( ( uint32_t )( x[ 5 ] ) <<  8 ) |
-             ( ( uint32_t )( x[ 6 ] ) << 16 ) |
-             ( ( uint32_t )( x[ 7 ] ) << 24 ) ;
+      m = frame_get_head( UART1, &ack );
+      frame_get_data( UART1, x, n, m );
+
+      if( frame_get_tail( UART1 ) != 0 || m != n || ack != 0x00 ) {
+        continue;
+      }
     }
     else {
+        disk_trips++;
+        PL011_puth( UART1, 0x00 );        // write command
+        PL011_putc( UART1, '\n' );        // write EOL
+
+      if( PL011_geth( UART1 ) != 0x00 ) { // read  command
+        PL011_getc( UART1       );        // read  EOL
+        continue;
+      }
+
+      PL011_getc( UART1       );        // read  separator
+       data_geth( UART1, x, n );        // read  data
       PL011_getc( UART1       );        // read  EOL
     }
+
+    return ( ( uint32_t )( x[ 4 * i + 0 ] ) <<  0 ) |
+           ( ( uint32_t )( x[ 4 * i + 1 ] ) <<  8 ) |
+           ( ( uint32_t )( x[ 4 * i + 2 ] ) << 16 ) |
+           ( ( uint32_t )( x[ 4 * i + 3 ] ) << 24 ) ;
   }
 
   return -1;
 }
 
+uint32_t disk_get_block_num() {
+  return disk_get_conf( 0 );
+}
+
+uint32_t disk_get_block_len() {
+  return disk_get_conf( 1 );
+}
+
 void disk_wr( uint32_t a, const uint8_t* x, int n ) {
+  disk_drain();
+
   for( int i = 0; i < RETRY; i++ ) {
+    if( disk_mode == DISK_MODE_BIN ) {
+      uint8_t ack; int m;
+
+      disk_seq++;
+      frame_put_head( UART1, 0x01, 4 + n );
+      frame_put_addr( UART1, a           );
+      frame_put_data( UART1, x, n        );
+      frame_put_tail( UART1              );
+
+      m = frame_get_head( UART1, &ack );
+      frame_get_data( UART1, NULL, 0, m );
+
+      if( frame_get_tail( UART1 ) == 0 && ack == 0x00 ) {
+        return;
+      }
+
+      continue;
+    }
+
+      disk_trips++;
       PL011_puth( UART1, 0x01 );        // write command
       PL011_putc( UART1, ' '  );        // write separator
        addr_puth( UART1, a    );        // write address
       PL011_putc( UART1, ' '  );        // write separator
        data_puth( UART1, x, n );        // write data
       PL011_putc( UART1, '\n' );        // write EOL
-  
+
     if( PL011_geth( UART1 ) == 0x00 ) { // read  command
-      PL011_getc( UART1       );        // read  EOL  
+      PL011_getc( UART1       );        // read  EOL
 
       return;
     }
@@ -87,17 +263,38 @@ void disk_wr( uint32_t a, const uint8_t* x, int n ) {
       PL011_getc( UART1       );        // read  EOL
     }
   }
-  
+
   return;
 }
 
 void disk_rd( uint32_t a,       uint8_t* x, int n ) {
+  disk_drain();
+
   for( int i = 0; i < RETRY; i++ ) {
+    if( disk_mode == DISK_MODE_BIN ) {
+      uint8_t ack; int m;
+
+      disk_seq++;
+      frame_put_head( UART1, 0x02, 4 );
+      frame_put_addr( UART1, a       );
+      frame_put_tail( UART1          );
+
+      m = frame_get_head( UART1, &ack );
+      frame_get_data( UART1, x, n, m );
+
+      if( frame_get_tail( UART1 ) == 0 && m >= n && ack == 0x00 ) {
+        return;
+      }
+
+      continue;
+    }
+
+      disk_trips++;
       PL011_puth( UART1, 0x02 );        // write command
       PL011_putc( UART1, ' '  );        // write separator
        addr_puth( UART1, a    );        // write address
       PL011_putc( UART1, '\n' );        // write EOL
-  
+
     if( PL011_geth( UART1 ) == 0x00 ) { // read  command
       PL011_getc( UART1       );        // read  separator
        data_geth( UART1, x, n );        // read  data
@@ -112,3 +309,442 @@ void disk_rd( uint32_t a,       uint8_t* x, int n ) {
 
   return;
 }
+
+/* The multi-block operations below move a whole run, or list, of blocks
+ * per request/acknowledgement round trip; they're only understood by a
+ * disk that speaks the binary encoding, so in hex we simply fall back
+ * to one block at a time.
+ */
+
+void disk_wrn( uint32_t a, const uint8_t* x, int n ) {
+  disk_drain();
+
+  if( disk_mode != DISK_MODE_BIN ) {
+    for( int i = 0; i < n; i++ ) {
+      disk_wr( a + i, x + i * disk_blen, disk_blen );
+    }
+
+    return;
+  }
+
+  for( int i = 0; i < RETRY; i++ ) {
+    uint8_t ack; int m;
+
+    disk_seq++;
+    frame_put_head( UART1, 0x04, 8 + n * disk_blen );
+    frame_put_addr( UART1, a                       );
+    frame_put_addr( UART1, n                       );
+    frame_put_data( UART1, x, n * disk_blen        );
+    frame_put_tail( UART1                          );
+
+    m = frame_get_head( UART1, &ack );
+    frame_get_data( UART1, NULL, 0, m );
+
+    if( frame_get_tail( UART1 ) == 0 && ack == 0x00 ) {
+      return;
+    }
+  }
+}
+
+void disk_rdn( uint32_t a,       uint8_t* x, int n ) {
+  disk_drain();
+
+  if( disk_mode != DISK_MODE_BIN ) {
+    for( int i = 0; i < n; i++ ) {
+      disk_rd( a + i, x + i * disk_blen, disk_blen );
+    }
+
+    return;
+  }
+
+  for( int i = 0; i < RETRY; i++ ) {
+    uint8_t ack; int m;
+
+    disk_seq++;
+    frame_put_head( UART1, 0x05, 8 );
+    frame_put_addr( UART1, a       );
+    frame_put_addr( UART1, n       );
+    frame_put_tail( UART1          );
+
+    m = frame_get_head( UART1, &ack );
+    frame_get_data( UART1, x, n * disk_blen, m );
+
+    if( frame_get_tail( UART1 ) == 0 && m == n * disk_blen && ack == 0x00 ) {
+      return;
+    }
+  }
+}
+
+void disk_wrv( const uint32_t* a, const uint8_t* const* x, int n ) {
+  disk_drain();
+
+  if( disk_mode != DISK_MODE_BIN ) {
+    for( int i = 0; i < n; i++ ) {
+      disk_wr( a[ i ], x[ i ], disk_blen );
+    }
+
+    return;
+  }
+
+  for( int i = 0; i < RETRY; i++ ) {
+    uint8_t ack; int m;
+
+    disk_seq++;
+    frame_put_head( UART1, 0x06, 4 + n * ( 4 + disk_blen ) );
+    frame_put_addr( UART1, n                                );
+
+    for( int j = 0; j < n; j++ ) {
+      frame_put_addr( UART1, a[ j ]            );
+      frame_put_data( UART1, x[ j ], disk_blen );
+    }
+
+    frame_put_tail( UART1 );
+
+    m = frame_get_head( UART1, &ack );
+    frame_get_data( UART1, NULL, 0, m );
+
+    if( frame_get_tail( UART1 ) == 0 && ack == 0x00 ) {
+      return;
+    }
+  }
+}
+
+void disk_rdv( const uint32_t* a,       uint8_t* const* x, int n ) {
+  disk_drain();
+
+  if( disk_mode != DISK_MODE_BIN ) {
+    for( int i = 0; i < n; i++ ) {
+      disk_rd( a[ i ], x[ i ], disk_blen );
+    }
+
+    return;
+  }
+
+  for( int i = 0; i < RETRY; i++ ) {
+    uint8_t ack; int m;
+
+    disk_seq++;
+    frame_put_head( UART1, 0x07, 4 + n * 4 );
+    frame_put_addr( UART1, n               );
+
+    for( int j = 0; j < n; j++ ) {
+      frame_put_addr( UART1, a[ j ] );
+    }
+
+    frame_put_tail( UART1 );
+
+    m = frame_get_head( UART1, &ack );
+
+    if( m == n * disk_blen ) {
+      for( int j = 0; j < n; j++ ) {
+        frame_get_data( UART1, x[ j ], disk_blen, disk_blen );
+      }
+    }
+    else {
+      frame_get_data( UART1, NULL, 0, m );
+    }
+
+    if( frame_get_tail( UART1 ) == 0 && m == n * disk_blen && ack == 0x00 ) {
+      return;
+    }
+  }
+}
+
+/* A copy moves runs of blocks from one place on the disk to another
+ * without any of them crossing the wire, so a request costs the same
+ * however many blocks it copies. It's understood by any disk that has
+ * the command, in either encoding; an older disk fails it, which isn't
+ * worth retrying, so the caller copies the blocks through itself.
+ */
+
+int disk_copy( const uint32_t* s, const uint32_t* d, const uint32_t* n, int m ) {
+  disk_drain();
+
+  for( int i = 0; i < RETRY; i++ ) {
+    if( disk_mode == DISK_MODE_BIN ) {
+      uint8_t ack; int k;
+
+      disk_seq++;
+      frame_put_head( UART1, 0x08, 4 + m * 12 );
+      frame_put_addr( UART1, m                );
+
+      for( int j = 0; j < m; j++ ) {
+        frame_put_addr( UART1, s[ j ] );
+        frame_put_addr( UART1, d[ j ] );
+        frame_put_addr( UART1, n[ j ] );
+      }
+
+      frame_put_tail( UART1 );
+
+      k = frame_get_head( UART1, &ack );
+      frame_get_data( UART1, NULL, 0, k );
+
+      if( frame_get_tail( UART1 ) != 0 ) {
+        continue;                       // garbled: try again
+      }
+
+      return ack == 0x00 ? 0 : -1;
+    }
+
+      disk_trips++;
+      PL011_puth( UART1, 0x08 );        // write command
+      PL011_putc( UART1, ' '  );        // write separator
+       addr_puth( UART1, m    );        // write run count
+
+    for( int j = 0; j < m; j++ ) {
+      PL011_putc( UART1, ' '  );        // write separator
+       addr_puth( UART1, s[ j ] );      // write source
+      PL011_putc( UART1, ' '  );        // write separator
+       addr_puth( UART1, d[ j ] );      // write destination
+      PL011_putc( UART1, ' '  );        // write separator
+       addr_puth( UART1, n[ j ] );      // write length
+    }
+
+      PL011_putc( UART1, '\n' );        // write EOL
+
+    int ack = PL011_geth( UART1 );      // read  command
+      PL011_getc( UART1       );        // read  EOL
+
+    return ack == 0x00 ? 0 : -1;
+  }
+
+  return -1;
+}
+
+// === ASYNCHRONOUS REQUESTS ===
+
+/* Queued requests are scheduled like an elevator (C-SCAN): the next one
+ * sent is that with the lowest address at or beyond the last one read,
+ * wrapping around to the lowest address once none is left. Rather than
+ * send it alone, every other queued request that fits is merged into a
+ * single transfer, sorted by address so that a run of consecutive blocks
+ * needs no address list; when the transfer completes, each request that
+ * went into it is completed in turn.
+ *
+ * The acknowledgement is parsed a byte at a time, as the receive
+ * interrupt delivers it, by the state machine in disk_rx; payload goes
+ * straight into the buffers of the requests, so nothing is copied once
+ * the frame completes.
+ */
+
+static disk_req_t* tx_r[ DISK_QUEUE_LIMIT ]; // requests merged into the transfer in flight
+static int         tx_nr = 0;
+static uint32_t    tx_a[ DISK_REQ_LIMIT ];   // its block addresses, ascending
+static uint8_t*    tx_x[ DISK_REQ_LIMIT ];   // its block buffers
+static int         tx_n = 0;
+static int         tx_retry;                 // number of attempts so far
+
+static enum {
+  RX_SOF,  // waiting for the start of a frame
+  RX_HEAD, // receiving cmd/ack, seq and length
+  RX_DATA, // receiving payload
+  RX_TAIL  // receiving checksum
+} rx_state = RX_SOF;
+
+static uint8_t  rx_head[ 6 ];   // cmd/ack, seq, length
+static uint8_t  rx_tail[ 2 ];   // checksum
+static uint32_t rx_i, rx_n;     // bytes received of the current field, payload length
+static int      rx_keep;        // frame acknowledges the transfer in flight
+static uint8_t  rx_s1, rx_s2;   // running Fletcher-16 checksum
+
+static void disk_send() {
+  int run = 1; // consecutive addresses need no address list
+
+  for( int i = 1; i < tx_n && run; i++ ) {
+    run = tx_a[ i ] == tx_a[ 0 ] + i;
+  }
+
+  disk_seq++;
+
+  if( tx_n == 1 ) {
+    frame_put_head( UART1, 0x02, 4 );
+    frame_put_addr( UART1, tx_a[ 0 ] );
+  }
+  else if( run ) {
+    frame_put_head( UART1, 0x05, 8 );
+    frame_put_addr( UART1, tx_a[ 0 ] );
+    frame_put_addr( UART1, tx_n      );
+  }
+  else {
+    frame_put_head( UART1, 0x07, 4 + tx_n * 4 );
+    frame_put_addr( UART1, tx_n               );
+
+    for( int i = 0; i < tx_n; i++ ) {
+      frame_put_addr( UART1, tx_a[ i ] );
+    }
+  }
+
+  frame_put_tail( UART1 );
+
+  rx_state = RX_SOF;
+}
+
+// the next queued request in C-SCAN order, or NULL if none (fits)
+static disk_req_t* disk_pick( int m ) {
+  disk_req_t* r = NULL;
+
+  for( int i = 0; i < DISK_QUEUE_LIMIT; i++ ) {
+    disk_req_t* q = &dq_pool[ i ];
+
+    if( q->n == 0 || q->sent || tx_n + q->n > m ) {
+      continue;                         // free, in flight or too big
+    }
+
+    int above_q = q->a[ 0 ] >= dq_pos;
+    int above_r = r != NULL && r->a[ 0 ] >= dq_pos;
+
+    if( r == NULL || ( above_q && !above_r ) || ( above_q == above_r && q->a[ 0 ] < r->a[ 0 ] ) ) {
+      r = q;
+    }
+  }
+
+  return r;
+}
+
+// merge as many queued requests as fit into one transfer, then send it
+static void disk_dispatch() {
+  disk_req_t* r;
+
+  tx_nr = tx_n = tx_retry = 0;
+
+  while( ( r = disk_pick( DISK_REQ_LIMIT ) ) != NULL ) {
+    r->sent = 1;
+    tx_r[ tx_nr++ ] = r;
+
+    for( int i = 0; i < r->n; i++ ) {   // insert blocks in address order
+      int j = tx_n++;
+
+      for( ; j > 0 && tx_a[ j - 1 ] > r->a[ i ]; j-- ) {
+        tx_a[ j ] = tx_a[ j - 1 ]; tx_x[ j ] = tx_x[ j - 1 ];
+      }
+
+      tx_a[ j ] = r->a[ i ]; tx_x[ j ] = r->x[ i ];
+    }
+
+    dq_pos = r->a[ r->n - 1 ];
+  }
+
+  if( tx_nr > 0 ) {
+    disk_send();
+  }
+}
+
+static void disk_done( int status ) {
+  if( status != 0 && ++tx_retry < RETRY ) {
+    disk_send();                        // try again
+    return;
+  }
+
+  for( int i = 0; i < tx_nr; i++ ) {
+    tx_r[ i ]->status = status;
+    tx_r[ i ]->done( tx_r[ i ] );
+    tx_r[ i ]->n      = 0;              // free
+  }
+
+  disk_dispatch();
+}
+
+static void disk_rx( uint8_t x ) {
+  if( rx_state != RX_SOF && rx_state != RX_TAIL ) {
+    rx_s1 = ( rx_s1 + x     ) % 255;
+    rx_s2 = ( rx_s2 + rx_s1 ) % 255;
+  }
+
+  switch( rx_state ) {
+    case RX_SOF  : {
+      if( x == FRAME_SOF ) {
+        rx_state = RX_HEAD; rx_i = 0; rx_s1 = rx_s2 = 0;
+      }
+      break;
+    }
+    case RX_HEAD : {
+      rx_head[ rx_i++ ] = x;
+
+      if( rx_i == 6 ) {
+        rx_n    = ( ( uint32_t )( rx_head[ 2 ] ) <<  0 ) |
+                  ( ( uint32_t )( rx_head[ 3 ] ) <<  8 ) |
+                  ( ( uint32_t )( rx_head[ 4 ] ) << 16 ) |
+                  ( ( uint32_t )( rx_head[ 5 ] ) << 24 ) ;
+        rx_keep = tx_nr > 0 && rx_head[ 1 ] == disk_seq;
+
+        rx_state = rx_n > 0 ? RX_DATA : RX_TAIL; rx_i = 0;
+      }
+      break;
+    }
+    case RX_DATA : {
+      if( rx_keep && rx_i < tx_n * disk_blen ) {
+        tx_x[ rx_i / disk_blen ][ rx_i % disk_blen ] = x;
+      }
+
+      if( ++rx_i == rx_n ) {
+        rx_state = RX_TAIL; rx_i = 0;
+      }
+      break;
+    }
+    case RX_TAIL : {
+      rx_tail[ rx_i++ ] = x;
+
+      if( rx_i == 2 ) {
+        rx_state = RX_SOF;
+
+        if( rx_keep ) {                 // anything else is stale: ignore it
+          int ok = rx_tail[ 0 ] == rx_s1 && rx_tail[ 1 ] == rx_s2 &&
+                   rx_head[ 0 ] == 0x00  && rx_n == tx_n * disk_blen;
+
+          disk_done( ok ? 0 : -1 );
+        }
+      }
+      break;
+    }
+  }
+}
+
+disk_req_t* disk_rdv_async( const uint32_t* a, uint8_t* const* x, int n, void (*done)( disk_req_t* r ) ) {
+  disk_req_t* r = NULL;
+
+  if( disk_mode != DISK_MODE_BIN || n < 1 || n > DISK_REQ_LIMIT ) {
+    return NULL;                        // only the binary encoding can be parsed a byte at a time
+  }
+
+  for( int i = 0; i < DISK_QUEUE_LIMIT && r == NULL; i++ ) {
+    if( dq_pool[ i ].n == 0 ) {
+      r = &dq_pool[ i ];
+    }
+  }
+
+  if( r == NULL ) {
+    return NULL;                        // queue full
+  }
+
+  for( int i = 0; i < n; i++ ) {
+    r->a[ i ] = a[ i ];
+    r->x[ i ] = x[ i ];
+  }
+
+  r->n      = n;
+  r->status = 0;
+  r->sent   = 0;
+  r->done   = done;
+
+  if( tx_nr == 0 ) {
+    disk_dispatch();                    // disk idle: send it now, else it waits its turn
+  }
+
+  return r;
+}
+
+void disk_irq() {
+  while( PL011_can_getc( UART1 ) ) {
+    disk_rx( PL011_getc( UART1 ) );
+  }
+}
+
+void disk_drain() {
+  while( tx_nr > 0 ) {
+    disk_rx( PL011_getc( UART1 ) );
+  }
+}
+
+uint32_t disk_get_trips() {
+  return disk_trips;
+}
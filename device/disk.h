@@ -10,6 +10,30 @@
 
 #define RETRY ( 3 )
 
+#define DISK_MODE_HEX ( 0x00 ) // hexified, line based requests
+#define DISK_MODE_BIN ( 0x01 ) // raw, framed          requests
+
+#define FRAME_SOF     ( 0xA5 ) // start of (binary) frame
+
+#define DISK_QUEUE_LIMIT ( 8  ) // max number of queued asynchronous requests
+#define DISK_REQ_LIMIT   ( 16 ) // max number of blocks read by one asynchronous request
+#define DISK_COPY_LIMIT  ( 32 ) // max number of runs copied by one copy request
+
+typedef struct disk_req {
+  int       n;                           // number of blocks
+  uint32_t  a[ DISK_REQ_LIMIT ];         // block addresses (ascending)
+  uint8_t*  x[ DISK_REQ_LIMIT ];         // block buffers
+  int       sent;                        // part of the transfer in flight
+  int       status;                      // 0 once read, -1 if the read failed
+
+  void    (*done)( struct disk_req* r ); // completion callback
+} disk_req_t; // asynchronous request
+
+// negotiate the binary encoding with the disk, falling back to hex
+extern void     disk_init();
+// query the encoding in use
+extern int      disk_get_mode();
+
 // query the disk block count
 extern uint32_t disk_get_block_num();
 // query the disk block length
@@ -20,4 +44,35 @@ extern void     disk_wr( uint32_t a, const uint8_t* x, int n );
 // read  an n-byte block of data x from the disk at block address a
 extern void     disk_rd( uint32_t a,       uint8_t* x, int n );
 
+// write n consecutive blocks of data x to   the disk, starting at block address a
+extern void     disk_wrn( uint32_t a, const uint8_t* x, int n );
+// read  n consecutive blocks of data x from the disk, starting at block address a
+extern void     disk_rdn( uint32_t a,       uint8_t* x, int n );
+
+// write n blocks to   the disk, block x[ i ] to   block address a[ i ]
+extern void     disk_wrv( const uint32_t* a, const uint8_t* const* x, int n );
+// read  n blocks from the disk, block x[ i ] from block address a[ i ]
+extern void     disk_rdv( const uint32_t* a,       uint8_t* const* x, int n );
+
+// copy m runs of blocks within the disk, n[ i ] blocks from block address s[ i ] to d[ i ]; 0 on success, -1 if the disk can't
+extern int      disk_copy( const uint32_t* s, const uint32_t* d, const uint32_t* n, int m );
+
+/* The asynchronous interface queues a read, then returns at once: the
+ * queue is served in elevator order, merging queued reads into as few
+ * transfers as possible, and each is completed by disk_irq as the
+ * acknowledgement arrives, calling done (from the interrupt handler)
+ * with the blocks read. Any of the synchronous calls above first waits
+ * for the queue to empty, since the disk answers one request at a time.
+ */
+
+// queue a read of n blocks, block x[ i ] from block address a[ i ] (NULL if it can't be queued)
+extern disk_req_t* disk_rdv_async( const uint32_t* a, uint8_t* const* x, int n, void (*done)( disk_req_t* r ) );
+// handle a UART1 receive interrupt, progressing the request in flight
+extern void     disk_irq();
+// wait (polling UART1) for every queued request to complete
+extern void     disk_drain();
+
+// query the number of requests sent to the disk, i.e., round trips made
+extern uint32_t disk_get_trips();
+
 #endif
@@ -1,13 +1,39 @@
-import argparse, binascii, logging, socket, struct, sys
+import argparse, binascii, logging, operator, socket, struct, sys
 
-REQ_CONF = '00'
-REQ_WR   = '01'
-REQ_RD   = '02'
+REQ_CONF = 0x00
+REQ_WR   = 0x01
+REQ_RD   = 0x02
+REQ_MODE = 0x03
+REQ_WRN  = 0x04
+REQ_RDN  = 0x05
+REQ_WRV  = 0x06
+REQ_RDV  = 0x07
+REQ_CPY  = 0x08
 
-ACK_OKAY = '00'
-ACK_FAIL = '01'
+ACK_OKAY = 0x00
+ACK_FAIL = 0x01
 
-# 00 command means a query operation: we pack the block size 
+MODE_HEX = 0x00
+MODE_BIN = 0x01
+
+# A binary frame is laid out as
+#
+# SOF | cmd/ack | seq | length (4 bytes) | payload (length bytes) | checksum (2 bytes)
+#
+# where all multi-byte fields are little-endian, and the checksum is a
+# Fletcher-16 sum over everything between SOF and the checksum itself;
+# an acknowledgement echoes the sequence number of its request.
+
+FRAME_SOF = 0xA5
+
+def fletcher16( data ) :
+  x = bytearray( data ) ; n = len( x )
+
+  # closed form of the running sums: byte i contributes n - i times to s2
+
+  return sum( x ) % 255, sum( map( operator.mul, x, xrange( n, 0, -1 ) ) ) % 255
+
+# 00 command means a query operation: we pack the block size
 # and count into a single datum, then return it.
 
 def conf( req ) :
@@ -21,16 +47,19 @@ def conf( req ) :
 # - we write the block to   the disk, then flush  the data.
 
 def   wr( req ) :
-  address = struct.unpack( '<l', binascii.unhexlify( req[ 1 ] ) )[ 0 ]
-  data    =                      binascii.unhexlify( req[ 2 ] )
+  if( len( req ) < 4 ) :
+    return [ ACK_FAIL ]
 
-  print address
+  address = struct.unpack( '<l', req[ 0 : 4 ] )[ 0 ]
+  data    =                      req[ 4 :   ]
 
-  if( address >= args.block_num ) :
+  logging.debug( 'wr %d' % ( address ) )
+
+  if( address < 0 or address >= args.block_num ) :
     return [ ACK_FAIL ]
 
-  fd.seek( address * args.block_len ) 
-  fd.write( data )
+  fd.seek( address * args.block_len )
+  fd.write( data[ : args.block_len ] )
 
   fd.flush()
 
@@ -41,20 +70,218 @@ def   wr( req ) :
 # - we read  the block from the disk, then return the data.
 
 def   rd( req ) :
-  address = struct.unpack( '<l', binascii.unhexlify( req[ 1 ] ) )[ 0 ]
+  if( len( req ) < 4 ) :
+    return [ ACK_FAIL ]
 
-  print address
+  address = struct.unpack( '<l', req[ 0 : 4 ] )[ 0 ]
 
-  if( address >= args.block_num ) :
+  logging.debug( 'rd %d' % ( address ) )
+
+  if( address < 0 or address >= args.block_num ) :
     return [ ACK_FAIL ]
 
   fd.seek( address * args.block_len )
   data = fd.read( args.block_len )
 
+  return [ ACK_OKAY, data ]
+
+# 03 command means a mode negotiation: the kernel asks whether it can
+# switch the encoding of every subsequent request, and we acknowledge
+# if we support it. Older disks don't know this command and so simply
+# fail it, which leaves the kernel to carry on in hex.
+
+def mode( req ) :
+  if( len( req ) < 1 or ord( req[ 0 ] ) not in [ MODE_HEX, MODE_BIN ] ) :
+    return [ ACK_FAIL ]
+
+  logging.info( 'encoding = ' + [ 'hex', 'binary' ][ ord( req[ 0 ] ) ] )
+
+  return [ ACK_OKAY ]
+
+# 04 command means a multi-block write operation:
+# - if any address in the run is invalid the request fails, else
+# - we write the n consecutive blocks to   the disk, then flush  the data.
+
+def  wrn( req ) :
+  if( len( req ) < 8 ) :
+    return [ ACK_FAIL ]
+
+  address, n = struct.unpack( '<ll', req[ 0 : 8 ] )
+  data       =                       req[ 8 :   ]
+
+  logging.debug( 'wrn %d+%d' % ( address, n ) )
+
+  if( address < 0 or n < 0 or address + n > args.block_num or len( data ) != n * args.block_len ) :
+    return [ ACK_FAIL ]
+
+  fd.seek( address * args.block_len )
+  fd.write( data )
+
   fd.flush()
 
+  return [ ACK_OKAY       ]
+
+# 05 command means a multi-block read  operation:
+# - if any address in the run is invalid the request fails, else
+# - we read  the n consecutive blocks from the disk, then return the data.
+
+def  rdn( req ) :
+  if( len( req ) < 8 ) :
+    return [ ACK_FAIL ]
+
+  address, n = struct.unpack( '<ll', req[ 0 : 8 ] )
+
+  logging.debug( 'rdn %d+%d' % ( address, n ) )
+
+  if( address < 0 or n < 0 or address + n > args.block_num ) :
+    return [ ACK_FAIL ]
+
+  fd.seek( address * args.block_len )
+  data = fd.read( n * args.block_len )
+
   return [ ACK_OKAY, data ]
 
+# 06 command means a scatter write operation, i.e., a list of n (address,
+# block) pairs:
+# - if any address in the list is invalid the request fails, else
+# - we write each block to   the disk, then flush  the data.
+
+def  wrv( req ) :
+  if( len( req ) < 4 ) :
+    return [ ACK_FAIL ]
+
+  n = struct.unpack( '<l', req[ 0 : 4 ] )[ 0 ] ; m = 4 + args.block_len
+
+  if( n < 0 or len( req ) != 4 + n * m ) :
+    return [ ACK_FAIL ]
+
+  blocks = [ ( struct.unpack( '<l', req[ 4 + i * m : 8 + i * m ] )[ 0 ], req[ 8 + i * m : 4 + ( i + 1 ) * m ] ) for i in range( n ) ]
+
+  logging.debug( 'wrv %s' % ( str( [ address for ( address, data ) in blocks ] ) ) )
+
+  if( any( address < 0 or address >= args.block_num for ( address, data ) in blocks ) ) :
+    return [ ACK_FAIL ]
+
+  for ( address, data ) in blocks :
+    fd.seek( address * args.block_len )
+    fd.write( data )
+
+  fd.flush()
+
+  return [ ACK_OKAY       ]
+
+# 07 command means a gather  read  operation, i.e., a list of n addresses:
+# - if any address in the list is invalid the request fails, else
+# - we read  each block from the disk, then return the data (in order).
+
+def  rdv( req ) :
+  if( len( req ) < 4 ) :
+    return [ ACK_FAIL ]
+
+  n = struct.unpack( '<l', req[ 0 : 4 ] )[ 0 ]
+
+  if( n < 0 or len( req ) != 4 + 4 * n ) :
+    return [ ACK_FAIL ]
+
+  addresses = struct.unpack( '<%dl' % ( n ), req[ 4 : ] )
+
+  logging.debug( 'rdv %s' % ( str( addresses ) ) )
+
+  if( any( address < 0 or address >= args.block_num for address in addresses ) ) :
+    return [ ACK_FAIL ]
+
+  data = ''
+
+  for address in addresses :
+    fd.seek( address * args.block_len )
+    data += fd.read( args.block_len )
+
+  return [ ACK_OKAY, data ]
+
+# 08 command means a copy      operation, i.e., a list of n (source,
+# destination, length) runs of blocks:
+# - if any address in either run is invalid the request fails, else
+# - we copy each run within the disk, then flush  the data.
+#
+# No block crosses the wire, so copying a file costs the same whatever
+# its length; each run is read in full before it's written, so a run may
+# overlap its own destination.
+
+def  cpy( req ) :
+  if( len( req ) < 4 ) :
+    return [ ACK_FAIL ]
+
+  n = struct.unpack( '<l', req[ 0 : 4 ] )[ 0 ]
+
+  if( n < 0 or len( req ) != 4 + 12 * n ) :
+    return [ ACK_FAIL ]
+
+  runs = [ struct.unpack( '<lll', req[ 4 + i * 12 : 16 + i * 12 ] ) for i in range( n ) ]
+
+  logging.debug( 'cpy %s' % ( str( runs ) ) )
+
+  if( any( src < 0 or dst < 0 or k < 0 or src + k > args.block_num or dst + k > args.block_num for ( src, dst, k ) in runs ) ) :
+    return [ ACK_FAIL ]
+
+  for ( src, dst, k ) in runs :
+    fd.seek( src * args.block_len )
+    data = fd.read( k * args.block_len )
+    fd.seek( dst * args.block_len )
+    fd.write( data )
+
+  fd.flush()
+
+  return [ ACK_OKAY       ]
+
+handlers = { REQ_CONF : conf, REQ_WR  : wr,  REQ_RD  : rd,  REQ_MODE : mode,
+             REQ_WRN  : wrn,  REQ_RDN : rdn, REQ_WRV : wrv, REQ_RDV  : rdv,
+             REQ_CPY  : cpy  }
+
+# Each request is decoded into a command plus a raw payload, whatever
+# the encoding it arrived in, so the handlers above are shared:
+#
+# - hex    requests are lines of space separated hexified fields, and
+# - binary requests are frames starting with SOF (which can't ever
+#   start a hex line, so the two are told apart by the first byte).
+
+def read_hex( c ) :
+  line = c + sd.readline()
+
+  if( line == c and c == '' ) :
+    raise EOFError
+
+  req = line.strip().split( ' ' )
+
+  return int( req[ 0 ], 16 ), None, binascii.unhexlify( ''.join( req[ 1 : ] ) )
+
+def read_bin() :
+  head = sd.read( 6 )
+  if( len( head ) < 6 ) :
+    raise EOFError
+
+  cmd, seq, n = struct.unpack( '<BBL', head ) ; data = sd.read( n ) ; tail = sd.read( 2 )
+  if( len( data ) < n or len( tail ) < 2 ) :
+    raise EOFError
+
+  if( fletcher16( head + data ) != struct.unpack( '<BB', tail ) ) :
+    logging.info( 'checksum mismatch on request %d' % ( seq ) ) ; cmd = None
+
+  return cmd, seq, data
+
+def write_hex( ack ) :
+  if ( len( ack ) > 1 ) :
+    ack = '%02X' % ( ack[ 0 ] ) + ' ' + ' '.join( [ binascii.hexlify( x ) for x in ack[ 1 : ] ] )
+  else :
+    ack = '%02X' % ( ack[ 0 ] )
+
+  sd.write( ack + '\n' ) ; sd.flush()
+
+def write_bin( ack, seq ) :
+  data = ''.join( ack[ 1 : ] )
+  head = struct.pack( '<BBL', ack[ 0 ], seq, len( data ) )
+
+  sd.write( chr( FRAME_SOF ) + head + data + struct.pack( '<BB', *fletcher16( head + data ) ) ) ; sd.flush()
+
 # The command line interface basically just parses the arguments
 # which configure the disk etc. then enters an infinite loop: it
 # reads requests and writes acknowledgements one at a time until
@@ -72,6 +299,7 @@ if ( __name__ == '__main__' ) :
   parser.add_argument( '--block-num', type =  int, action = 'store'      )
   parser.add_argument( '--block-len', type =  int, action = 'store'      )
 
+  parser.add_argument( '--hex-only',               action = 'store_true' )
   parser.add_argument( '--debug',                  action = 'store_true' )
 
   args = parser.parse_args()
@@ -83,40 +311,52 @@ if ( __name__ == '__main__' ) :
 
   logging.basicConfig( stream = sys.stdout, level = l, format = '%(filename)s : %(asctime)s : %(message)s', datefmt = '%d/%m/%y @ %H:%M:%S' )
 
+  if ( args.hex_only ) :
+    for cmd in [ REQ_MODE, REQ_WRN, REQ_RDN, REQ_WRV, REQ_RDV, REQ_CPY ] :
+      del handlers[ cmd ]
+
   # open disk image
 
   fd = open( args.file, 'rb+' )
-  
+
   # open network connection
 
   s = socket.socket( socket.AF_INET, socket.SOCK_STREAM )
-  
-  s.connect( ( args.host, args.port ) ) ; sd = s.makefile()
+
+  s.connect( ( args.host, args.port ) ) ; sd = s.makefile( 'rwb' )
+
+  s.setsockopt( socket.IPPROTO_TCP, socket.TCP_NODELAY, 1 )
 
   # read request, process it and write acknowledgement
-  
-  while ( True ) :
-    req = sd.readline().strip().split( ' ' )
-  
-    if   ( req[ 0 ] == REQ_CONF ) :
-      ack = conf( req )
-    elif ( req[ 0 ] == REQ_WR   ) :
-      ack =   wr( req )
-    elif ( req[ 0 ] == REQ_RD   ) :
-      ack =   rd( req )
-    else :
-      ack = [ ACK_FAIL ]
-
-    logging.debug( 'req = ' + str( req ) )  
-    logging.debug( 'ack = ' + str( ack ) )
-
-    if ( len( ack ) > 1 ) :
-      ack = ack[ 0 ] + ' ' + ' '.join( [ binascii.hexlify( x ) for x in ack[ 1 : ] ] )
-    else :
-      ack = ack[ 0 ]
-
-    sd.write( ack + '\n' ) ; sd.flush()
-  
+
+  try :
+    while ( True ) :
+      c = sd.read( 1 )
+
+      if   ( c == chr( FRAME_SOF ) ) :
+        cmd, seq, req = read_bin()
+      elif ( c == '\r' or c == '\n' ) :
+        continue
+      else :
+        cmd, seq, req = read_hex( c )
+
+      if ( cmd in handlers ) :
+        ack = handlers[ cmd ]( req )
+      else :
+        ack = [ ACK_FAIL ]
+
+      logging.debug( 'req = ' + str( cmd ) + ' ' + binascii.hexlify( req[ : 8 ] ) )
+      logging.debug( 'ack = ' + str( ack[ 0 ] ) )
+
+      # acknowledge in the same encoding the request arrived in
+
+      if ( seq == None ) :
+        write_hex( ack )
+      else :
+        write_bin( ack, seq )
+  except EOFError :
+    pass
+
   # close network connection
 
   sd.close()
@@ -0,0 +1,51 @@
+#ifndef __BCACHE_H
+#define __BCACHE_H
+
+#define BCACHE_LIMIT 48 // number of blocks held in the buffer cache (must exceed BATCH_LIMIT)
+#define BCACHE_HASH  16 // number of hash chains indexing the buffer cache
+
+// A syscall waiting on the disk is reissued from scratch once woken, so the
+// blocks fetched by its earlier waits must still be cached by then: after
+// this many waits it polls the disk instead, so it can't chase its own tail.
+#define IO_WAIT_LIMIT ( BCACHE_LIMIT / BATCH_LIMIT - 1 )
+
+typedef enum {
+  B_VALID = 0x01, // buffer holds the block at b_addr
+  B_DIRTY = 0x02, // buffer differs from the disk, so must be written back
+  B_BUSY  = 0x04, // buffer is being read in the background, so can't be used yet
+  B_AHEAD = 0x08  // buffer was read ahead, and hasn't been read since
+} bflag_t; // buffer flags
+
+typedef struct buf {
+  daddr32_t   b_addr;              // block address
+  uint32_t    b_flags;             // bflag_t bits
+
+  struct buf *b_prev, *b_next;     // LRU list (head is most recently used)
+  struct buf *b_hash;              // next buffer on the same hash chain
+
+  uint8_t     b_data[ BLOCK_SIZE ];
+} buf_t; // block buffer
+
+void   bcache_init();
+buf_t *bread( daddr32_t a );             // buffer holding block a, read from disk on a miss
+buf_t *bget( daddr32_t a );              // buffer for block a, *not* read (caller overwrites it all)
+buf_t *bfind( daddr32_t a );             // buffer holding block a if cached, NULL otherwise
+void   breadn( const daddr32_t *a, buf_t **b, int n ); // buffers b[ i ] holding blocks a[ i ], misses read in one go
+void   bfill( buf_t **b, int n, int w ); // read n (claimed) buffers from disk, waiting for them iff. w
+void   bdone( disk_req_t *r );           // background read completion
+void   bdirty( buf_t *b );               // mark buffer as needing write back
+int    bsync();                          // write back every dirty buffer
+
+// disk_rd / disk_wr equivalents that go via the cache
+void   bcache_rd( daddr32_t a,       uint8_t *x, int n );
+void   bcache_wr( daddr32_t a, const uint8_t *x, int n );
+
+// disk_rd / disk_wr equivalents for n blocks, block x[ i ] at address a[ i ]
+void   readBlocks( const daddr32_t *a, uint8_t * const *x, int n );        // via the cache
+void   prefetchBlocks( const daddr32_t *a, int n, int k );                 // into the cache, a[ k ] on read ahead
+void   writeBlocks( const daddr32_t *a, const uint8_t * const *x, int n ); // via the cache
+void   copyBlocks( const daddr32_t *s, const daddr32_t *d, int n );  // block s[ i ] to address d[ i ], by the disk where it can
+void   diskReadBlocks( const daddr32_t *a, uint8_t * const *x, int n );    // bypassing the cache
+void   diskWriteBlocks( const daddr32_t *a, const uint8_t * const *x, int n );
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef __DCACHE_H
+#define __DCACHE_H
+
+#define DCACHE_LIMIT 64 // number of names held in the dentry cache
+#define DCACHE_HASH  16 // number of hash chains indexing the dentry cache
+
+typedef struct dentry {
+  uint32_t       de_dir;                  // inode number of the directory looked in
+  int32_t        de_ino;                  // inode number the name maps to, -1 if it's in no entry (negative)
+  uint16_t       de_namlen;               // 0 if the dentry is unused
+  char           de_name[ MAXNAMLEN+1 ];
+
+  struct dentry *de_prev, *de_next;       // LRU list (head is most recently used)
+  struct dentry *de_hash;                 // next dentry on the same hash chain
+} dentry_t; // directory entry cache entry, i.e., the result of looking a name up in a directory
+
+void dcache_init();
+int  dlookup( uint32_t dir, const char *name, int len );          // cached inode number (or -1) of name in dir, -2 if not cached
+void denter( uint32_t dir, const char *name, int len, int ino );  // cache the inode number (or -1) of name in dir
+void dforget( uint32_t dir, const char *name, int len );          // drop name in dir, as its entries changed
+void dpurge( uint32_t dir );                                      // drop every name in dir, as it's gone
+
+#endif
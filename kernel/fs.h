@@ -6,11 +6,28 @@
 
 #define FDT_LIMIT 16                         // limit on number of file descriptor table entries (per process)
 #define OFT_LIMIT FDT_LIMIT * PROCESS_LIMIT  // limit on number of open file table entries       (global)
-#define AIT_LIMIT OFT_LIMIT                  // limit on number of active inode table entries    (global)
 
 #define NDADDR 11                            // number of direct blocks per icommon
 #define NIADDR 3                             // number of indirect blocks per icommon
+#define FIL_LIMIT 32                         // number of free inodes listed in the superblock
+#define NEXTENT 6                            // number of extents per icommon
+#define IDATA_LIMIT ( (NDADDR + NIADDR) * 4 ) // max number of bytes of data held inline in an icommon
+#define NXEXTENT ( BLOCK_SIZE / 8 )          // number of extents per extent block
 #define MAXNAMLEN 25                         // max number of characters in "inode name"
+#define DX_LIMIT 5                           // max number of hash index blocks per directory
+#define DX_SLOTS ( BLOCK_SIZE / 4 )          // number of hash index slots per index block
+#define PATH_LIMIT 128                       // max number of characters in a path
+
+#define BATCH_LIMIT 16                       // max number of blocks moved per multi-block disk request
+#define RA_INIT 2                            // initial read-ahead window, in blocks
+#define RA_LIMIT BATCH_LIMIT                 // max     read-ahead window, in blocks
+#define SYNC_PERIOD 1024                     // timer ticks between periodic write backs
+#define BMAP_LIMIT BLOCK_SIZE                // bytes of free-space bitmap (so a disk of at most 8 * BMAP_LIMIT blocks)
+#define RCNT_LIMIT ( 8 * BMAP_LIMIT )         // bytes of block reference counts (one per block, see reflink)
+#define RCNT_MAX 255                         // max number of extra references to a block
+#define IOV_PIECES 64                        // max number of segment pieces applied per batch of blocks (see transferFile)
+#define COPY_LIMIT 64                        // max number of blocks mapped per copy the disk is asked for (see sendBlocks)
+#define AIO_LIMIT 16                         // max number of asynchronous requests queued at once (see aio_submit)
 
 typedef uint32_t daddr32_t; // 32-bit disk block address
 
@@ -25,10 +42,20 @@ typedef struct {
   uint32_t  fs_fdbhead; // head of list of free data blocks
 
   daddr32_t fs_fdb[ 64 ]; // list of free data blocks (fs_fdb[ 0 ] points to block of more free addresses, etc.)
-  uint32_t  fs_fil[ 32 ]; // list of free inodes (CURRENTLY UNUSED)
+  uint32_t  fs_fil[ FIL_LIMIT ]; // list of free inodes (taken from the back, refilled by a scan once empty)
+
+  uint32_t  fs_clean;   // unmounted cleanly, so the free list can be trusted
+
+  uint32_t  fs_alloc;   // falloc_t: free list (fs_fdb), or free-space bitmap
+  daddr32_t fs_bmblkno; // block address of free-space bitmap (a set bit marks a block in use)
+  daddr32_t fs_rotor;   // block address next-fit allocation resumes from
+
+  uint32_t  fs_nfil;    // number of free inodes listed in fs_fil
+
+  daddr32_t fs_rcblkno; // block address of block reference counts (0 if none), the last blocks of the disk
 
-  uint8_t __pad__[100]; // usused space
-} fs_t; // superblock (defines the filesystem) - 412 < 512 bytes
+  uint8_t __pad__[76]; // usused space
+} fs_t; // superblock (defines the filesystem) - 512 bytes
 
 typedef enum {
   IFZERO = 0, // inode usused
@@ -37,11 +64,33 @@ typedef enum {
   IFREG  = 3, // regular data file
 } mode_t; // icommon (on-core inode) mode / type
 
+typedef enum {
+  IC_EXTENTS = 0x0001, // data blocks mapped by extents, rather than direct / indirect blocks
+  IC_INLINE  = 0x0002, // data held in the icommon itself, rather than in any data block
+  IC_DIRHASH = 0x0004, // directory entries indexed by a hash table (see dirdot_t)
+} icflag_t; // icommon format flags
+
 typedef struct {
-  uint32_t ic_mode;          // 0:       icommon type
-  uint32_t ic_size;          // 4:       size of icommon in bytes (ignores fragments)
-  daddr32_t ic_db[ NDADDR ]; // 8  - 48: direct   blocks
-  daddr32_t ic_ib[ NIADDR ]; // 52 - 60: indirect blocks
+  daddr32_t e_start; // block address of first block
+  uint32_t  e_len;   // number of (consecutive) blocks
+} extent_t; // extent (run of data blocks)
+
+typedef struct {
+  uint16_t ic_mode;            // 0:       icommon type
+  uint16_t ic_flags;           // 2:       icflag_t bits
+  uint32_t ic_size;            // 4:       size of icommon in bytes (ignores fragments)
+  union {
+    struct {
+      daddr32_t ic_db[ NDADDR ]; // 8  - 48: direct   blocks
+      daddr32_t ic_ib[ NIADDR ]; // 52 - 60: indirect blocks
+    };
+    struct {
+      extent_t  ic_ext[ NEXTENT ]; // 8  - 48: extents, in file order (iff. IC_EXTENTS)
+      uint32_t  ic_next;           // 56:      number of extents
+      daddr32_t ic_xb;             // 60:      extent block, holding those after the first NEXTENT
+    };
+    uint8_t ic_data[ IDATA_LIMIT ]; // 8  - 60: data (iff. IC_INLINE)
+  };
 } icommon_t; // on-core inode (64 bytes)
 
 typedef struct {
@@ -51,42 +100,129 @@ typedef struct {
 } dir_t; // directory - simplified to be small, static length (32 bytes) rather than varlength
 
 typedef struct {
+  uint32_t  d_ino;
+  uint16_t  d_namlen;
+  char      d_name[ 2 ];          // ".", then the rest of the name is free for:
+  uint32_t  dx_nblk;              // number of hash index blocks (iff. IC_DIRHASH)
+  daddr32_t dx_blk[ DX_LIMIT ];   // hash index blocks
+} dirdot_t; // "." entry of a directory (always its first), which locates its hash index
+
+typedef struct inode {
   uint32_t  i_number;
   uint32_t  i_links; // how many OFT entries link to this inode
   icommon_t i_ic;
+
+  // inode cache (see icache.h)
+  uint32_t      i_flags;          // iflag_t bits
+  uint32_t      i_gen;            // bumped whenever mapped blocks move (see getFileBlockAddr)
+  struct inode *i_prev, *i_next;  // LRU list (head is most recently used)
+  struct inode *i_hash;           // next inode on the same hash chain
 } inode_t; // in-core inode
 
 typedef struct {
   inode_t *o_inptr;
   uint32_t o_head; // r/w head position
+
+  // read-ahead (see fread)
+  uint32_t o_ranext; // position a sequential read would start at
+  uint32_t o_rawin;  // window, in blocks (0 unless reads are sequential)
+  uint32_t o_raend;  // block number up to which data has been read ahead
+
+  // block-map cursor (see getFileBlockAddr)
+  uint32_t  o_mgen;   // i_gen of the inode when the cursor was set
+  uint32_t  o_mext;   // extent it's in (extent mapped files)
+  uint32_t  o_mfirst; // first block of the file it covers
+  uint32_t  o_mlen;   // number of blocks it covers (0 if unset)
+  daddr32_t o_maddr;  // address of that first block, or of the index block mapping them
 } ofile_t; // open file
 
+typedef struct {
+  int      p_slot; // block it's in (index into the batch)
+  int      p_off;  // offset into that block
+  int      p_len;  // number of bytes
+  uint8_t *p_buf;  // where they're read into / written from
+} piece_t; // part of an I/O segment that lies within one block
+
+typedef enum {
+  AIO_READ,
+  AIO_WRITE,
+  AIO_FSYNC
+} aioop_t; // asynchronous request type
+
+typedef struct {
+  aioop_t  a_op;     // what's asked for
+  int      a_pid;    // process that queued it
+  ofile_t *a_ofile;  // file read / written (NULL for fsync)
+  aiocb_t  a_cb;     // its control block, as queued
+  int      a_done;   // carried out, so only its completion is left to post
+  int      a_result; // (iff. a_done)
+} aio_t; // queued asynchronous request
+
 // === BLOCK ALLOCATION FUNCTIONS ===
 
 daddr32_t balloc();
+daddr32_t ballocNear( daddr32_t goal );
+int ballocRun( daddr32_t goal, int n, daddr32_t *a );
+int ballocBlocks( daddr32_t goal, daddr32_t *a, int n );
 int bfree( daddr32_t a );
+int bshared( daddr32_t a );
+void rcdirty();
 
 // === SUPERBLOCK FUNCTIONS ===
 
-void wipe();
+void wipe( falloc_t alloc );
+void sbdirty();
+void sbflush();
+int unmount();
+void markDataBlocks( uint8_t *used, uint8_t *refs, const inode_t *inode );
+void recover();
 
 // === DATA BLOCK FUNCTIONS ===
 
+extent_t readExtent( const inode_t *inode, int i );
+void writeExtent( inode_t *inode, int i, extent_t e );
+daddr32_t getLeafIndex( const inode_t *inode, int blk, int *first );
 int getDataBlockAddr( const inode_t *inode, uint32_t byte );
+int getFileBlockAddr( ofile_t *ofile, uint32_t byte );
+int allocateDataBlockAddr( inode_t *inode, uint32_t byte );
+int appendExtent( inode_t *inode, extent_t e );
+daddr32_t extentGoal( const inode_t *inode );
+int allocateExtentBlocks( inode_t *inode, int n );
+int ownBlock( inode_t *inode, int blk, const int fill );
+int allocateMappedBlocks( inode_t *inode, int first, int n );
+int spillInline( inode_t *inode );
 int allocateDataBlocks( inode_t *inode, uint32_t n );
-int freeDataBlocks( inode_t *inode );
+int extendFile( inode_t *inode, uint32_t head, uint32_t end );
+void truncateIndex( daddr32_t ib, int span, int first, int keep, int end );
+void truncateBlocks( inode_t *inode, int keep );
+int truncateInode( inode_t *inode, uint32_t size );
 int getDataBlock( uint8_t *block, const inode_t *inode, uint32_t byte );
 
 // === INODE FUNCTIONS ===
 
-inode_t *copyInode( inode_t *copy, inode_t *inode );
 inode_t *readInode( inode_t *in, int ino );
 inode_t *writeInode( inode_t *inode );
+void refillFreeInodes();
 inode_t *getFreeInode( inode_t *in );
 dir_t *getLastDir( dir_t *d, const inode_t *inode );
 int removeable( inode_t *parent, dir_t *child );
 int remove( dir_t *child, inode_t *parent, const char *name );
+uint32_t dirHash( const char *name, int len );
+int dirMatch( const dir_t *d, const char *name, int len );
+dir_t *dirEntry( const inode_t *dir, int e );
+void readDot( const inode_t *dir, dirdot_t *dot );
+void writeDot( const inode_t *dir, const dirdot_t *dot );
+uint32_t *dxSlot( const dirdot_t *dot, int i, int w );
+const uint32_t *dxNext( const dirdot_t *dot, int i, const uint32_t *slot );
+int dxFind( const dirdot_t *dot, uint32_t h, int e );
+void dxInsert( const dirdot_t *dot, uint32_t h, int e );
+void dxDelete( const dirdot_t *dot, int i );
+int dxBuild( inode_t *dir, dirdot_t *dot, int nblk );
+void dxDrop( inode_t *dir, dirdot_t *dot );
+void dirIndexAdd( inode_t *dir, const char *name, int e );
+int dirFind( const inode_t *dir, const char *name, dir_t *d );
 int name_to_ino( const char *name, const inode_t *in );
+int dirLookup( const int dir, const char *name );
 int path_to_ino( char *path, const int dir );
 int path_to_ino2(  char *path, const int dir ); // also deals with creating new files
 
@@ -99,12 +235,31 @@ void addInodeToDirectory( inode_t* par, uint32_t ino, const char *name );
 int open( char *path, int oflag);
 int close( const int fd );
 int fwrite( const int fd, const uint8_t *data, const int n );
+uint32_t readAhead( ofile_t *ofile, const int n, const uint32_t win );
 int fread( const int fd, uint8_t *data, const int n );
+uint32_t sendBlocks( ofile_t *out, ofile_t *in, uint32_t pos, int k );
+int sendfile( const int out, const int in, uint32_t *offset, uint32_t count );
+int reflink( const int out, const int in );
+void transferPieces( const daddr32_t *a, const int *whole, int nb, const piece_t *p, int np, const int w );
+int transferFile( ofile_t *ofile, const iovec_t *iov, const int cnt, const int w );
+int transferv( const int fd, const iovec_t *iov, const int cnt, const int w );
+int fpread( const int fd, uint8_t *data, const int n, uint32_t offset );
+int fpwrite( const int fd, const uint8_t *data, const int n, uint32_t offset );
+int freadv( const int fd, const iovec_t *iov, const int cnt );
+int fwritev( const int fd, const iovec_t *iov, const int cnt );
+int aio_submit( aioop_t op, const aiocb_t *cb );
+int aioReady( const aio_t *r );
+void aioService( const int wait );
+void aioCancel( const int pid );
+int aioPending( const int mqd, const ofile_t *ofile );
 int lseek( const int fd, uint32_t offset, const int whence );
 int unlink(char *name);
 
 // === EXTRA FUNCTIONS ===
 
 int tell( const int fd );
+int truncate( const int fd, uint32_t length );
+int stat( char *path, stat_t *s );
+int getdents( char *path, uint32_t *cookie, dirent_t *d, const int n );
 
 #endif
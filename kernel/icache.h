@@ -0,0 +1,18 @@
+#ifndef __ICACHE_H
+#define __ICACHE_H
+
+#define ICACHE_LIMIT ( OFT_LIMIT + 32 ) // number of inodes held in the inode cache (must exceed OFT_LIMIT + 2)
+#define ICACHE_HASH  16                 // number of hash chains indexing the inode cache
+
+typedef enum {
+  I_VALID = 0x01, // entry holds the inode numbered i_number
+  I_DIRTY = 0x02  // entry differs from its inode block, so must be written back
+} iflag_t; // inode cache entry flags
+
+void     icache_init();
+inode_t *iget( uint32_t ino );       // cached inode ino, read from disk on a miss (NULL if every entry is in use)
+inode_t *ilookup( uint32_t ino );    // cached inode ino if cached, NULL otherwise
+void     iflush( inode_t *inode );   // copy a cached inode into (the cached copy of) its inode block
+void     isync();                    // flush every dirty (or open) cached inode
+
+#endif
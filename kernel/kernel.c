@@ -6,11 +6,37 @@ pcb_t* rq[ PROCESS_LIMIT ]; uint32_t rq_size;
 mqueue mq[ MSGCHAN_LIMIT ]; 
 
 ofile_t of[ OFT_LIMIT ]; uint32_t of_size; // open file table
-inode_t ai[ AIT_LIMIT ]; uint32_t ai_size; // available inodes table
 
 fs_t fs;      // filesystem metadata
+int  fs_dirty; // in-memory superblock (or bitmap) differs from the disk
+uint8_t fs_bmap[ BMAP_LIMIT ]; // free-space bitmap (iff. fs.fs_alloc != FS_LIST)
+uint8_t fs_rcnt[ RCNT_LIMIT ]; // extra references to each block, by reflinked files (iff. fs.fs_rcblkno != 0)
+int  fs_rcdirty; // in-memory reference counts differ from the disk
 uint32_t cwd; // current working directory inode
 
+uint8_t batch[ BATCH_LIMIT ][ BLOCK_SIZE ]; // staging blocks for multi-block transfers
+
+buf_t bc[ BCACHE_LIMIT ];                  // buffer cache
+buf_t *bc_head, *bc_tail;                  // LRU list ends (head is most recently used)
+buf_t *bc_hash[ BCACHE_HASH ];             // hash chains, keyed by block address
+buf_t bc_hole;                             // what a hole (block address 0) reads as: zeroes, never cached
+
+inode_t icache[ ICACHE_LIMIT ];            // inode cache
+inode_t *icache_head, *icache_tail;        // LRU list ends (head is most recently used)
+inode_t *icache_hash[ ICACHE_HASH ];       // hash chains, keyed by inode number
+
+dentry_t dcache[ DCACHE_LIMIT ];            // dentry cache
+dentry_t *dcache_head, *dcache_tail;       // LRU list ends (head is most recently used)
+dentry_t *dcache_hash[ DCACHE_HASH ];      // hash chains, keyed by directory and name
+
+iostat_t io_stats;                         // I/O counters
+uint32_t ticks;                            // timer interrupts so far
+int      sync_due;                         // a periodic write back is due (at the next syscall)
+
+jmp_buf io_jmp;                            // where a syscall waiting on the disk unwinds to
+int     io_async;                          // current syscall can wait on the disk
+int     aio_due;                           // queued asynchronous requests may have become ready (see aioService)
+
 // =================
 // === PROCESSES ===
 // =================
@@ -25,6 +51,7 @@ uint32_t fork( ctx_t* ctx ) {
       pcb[ p ].ctx.gpr[ 0 ]         = 0; // return value of child process
       pcb[ p ].pst                  = EXECUTING;
       pcb[ p ].defp = pcb[ p ].prio = 0x7FFFFFFF;
+      pcb[ p ].io_wait = pcb[ p ].io_block = 0;
 
       rq_add(p);
 
@@ -58,6 +85,8 @@ int exec( ctx_t* ctx, char *path ) {
   int pid = current->pid;
   int pst = current->pst;
 
+  aioCancel( pid ); // its buffers go with its stack
+
   memset( current, 0, sizeof( pcb_t ) );
   current->pid      = pid;
   current->pst      = pst;
@@ -78,6 +107,7 @@ void kill( pid_t pid, sig_t sig ) {
       case SIGKILL: { // enforced immediately
         pcb[ pid ].pst = TERMINATED;
         rq_rm( pid );
+        aioCancel( pid );
         break; 
       }
       case SIGWAIT: { // enforced immediately
@@ -99,6 +129,7 @@ void kill( pid_t pid, sig_t sig ) {
   else if (pid == 9 && sig == SIGKILL) {
     for (pid_t p = 1; p < PROCESS_LIMIT; p++) {
       pcb[ p ].pst = TERMINATED;
+      aioCancel( p );
     }
   }
 }
@@ -178,6 +209,14 @@ void rq_rm( pid_t pid ) {
 } 
 
 void scheduler( ctx_t* ctx ) {
+  // nothing can run: wait for the disk, which wakes whoever is waiting on it
+  int live = 0;
+  for (int i = 0; i < rq_size; i++) {
+    live |= rq[ i ]->pst == EXECUTING;
+  }
+  if (!live)
+    disk_drain();
+
   //qsort( rq, PROCESS_LIMIT, sizeof(pcb_t*), cmp_pcb );
   rq_rotate();
 
@@ -225,6 +264,8 @@ int mq_open(int name) {
       mq[ i ].msg_lspid = 0;
       mq[ i ].msg_lrpid = 0;
 
+      mq[ i ].msg_qnaio = 0;
+
       return i;
     }
   }
@@ -257,8 +298,40 @@ int mq_send(mqd_t mqd, uint8_t *msg_ptr, size_t msg_len) {
   return -1;
 }
 
+// queue the completion of an asynchronous request (see aio_submit), waking a receiver waiting on it
+int mq_post(mqd_t mqd, const aiocomp_t *c) {
+  if (mq[ mqd ].msg_qname == 0)
+    return 0; // unlinked: nobody to tell
+
+  if (mq[ mqd ].msg_qnaio == MQ_AIO_LIMIT)
+    return -1; // full: posted once some are received
+
+  mq[ mqd ].msg_qaio[ mq[ mqd ].msg_qnaio++ ] = *c;
+  if (mq[ mqd ].msg_qrec == 1) {
+    kill( mq[ mqd ].msg_lrpid, SIGCONT ); // wake receiver
+    mq[ mqd ].msg_qrec = 0;
+  }
+  return 0;
+}
+
 int mq_receive(mqd_t mqd, uint8_t *msg_ptr, size_t msg_len) {
   mq[ mqd ].msg_lrpid = current->pid;  
+  current->io_block   = 0;
+
+  // completions come first, as many as fit (carrying out the requests for them: waiting here if nothing else could run)
+  if (mq[ mqd ].msg_qnaio == 0 && aioPending( mqd, NULL ))
+    aioService( !io_ready() );
+
+  if (mq[ mqd ].msg_qnaio > 0 && msg_len >= sizeof( aiocomp_t )) {
+    const int k = msg_len / sizeof( aiocomp_t ) < mq[ mqd ].msg_qnaio ? msg_len / sizeof( aiocomp_t ) : mq[ mqd ].msg_qnaio;
+
+    memcpy( msg_ptr, mq[ mqd ].msg_qaio, k * sizeof( aiocomp_t ) );
+    memmove( mq[ mqd ].msg_qaio, mq[ mqd ].msg_qaio + k, (mq[ mqd ].msg_qnaio - k) * sizeof( aiocomp_t ) );
+    mq[ mqd ].msg_qnaio -= k;
+
+    aioService( 0 ); // room for any held back
+    return k * sizeof( aiocomp_t );
+  }
   
   // space on mqueue & last sender wasn't current receiver
   if (mq[ mqd ].msg_qnum > 0 && mq[ mqd ].msg_lspid != current->pid) { 
@@ -269,784 +342,3211 @@ int mq_receive(mqd_t mqd, uint8_t *msg_ptr, size_t msg_len) {
   }
 
   mq[ mqd ].msg_qrec = 1; // tells queue a process is waiting for data
+  if (aioPending( mqd, NULL ))
+    current->io_block = 1; // ... or for the disk to bring in what requests for it read
   kill( current->pid, SIGWAIT );
 
   return -1;
 }
 
-// ==================
-// === FILESYSTEM ===
-// ==================
+// ================
+// === DISK I/O ===
+// ================
+
+/* A process reading a block that isn't cached is put to sleep until the
+ * disk answers, so others can run meanwhile: the read is queued with the
+ * disk driver, then the syscall unwinds (via longjmp) to the svc handler
+ * which parks the process with its pc rewound onto the svc instruction.
+ * Once the receive interrupt completes the read, the process is woken and
+ * simply reissues the syscall, which now hits in the cache.
+ *
+ * This is only safe for syscalls that don't change anything before their
+ * last disk read, and is only worthwhile if some other process can run;
+ * anything else polls the disk, as before.
+ */
+
+// syscalls that can simply be reissued after waiting on the disk
+int io_restartable( ctx_t* ctx, uint32_t id ) {
+  switch (id) {
+    case 0x02 : return ctx->gpr[ 0 ] != STDIO;   // read
+    case 0x1e : return 1;                        // pread
+    case 0x20 : return 1;                        // readv
+    case 0x0c : return ctx->gpr[ 1 ] == O_EXIST; // open (existing file)
+    case 0x11 : return 1;                        // cd
+  }
 
-void createObjFiles() {
-  int FILE; int prio;
+  return 0;
+}
 
-  FILE = open( "P0", O_CREAT ); prio = 1;
-  fwrite( FILE, (uint8_t*)&entry_P0, 4 );
-  fwrite( FILE, (uint8_t*)&prio, 4 );
-  close( FILE );
+// can the current syscall wait on the disk, rather than poll it
+int io_ready() {
+  if (disk_get_mode() != DISK_MODE_BIN || current->io_wait >= IO_WAIT_LIMIT)
+    return 0;
 
-  FILE = open( "P1", O_CREAT ); prio = 1;
-  fwrite( FILE, (uint8_t*)&entry_P1, 4 );
-  fwrite( FILE, (uint8_t*)&prio, 4 );
-  close( FILE );
+  for (pid_t p = 0; p < PROCESS_LIMIT; p++) {
+    if (&pcb[ p ] != current && pcb[ p ].pst == EXECUTING)
+      return 1;
+  }
 
-  FILE = open( "P2", O_CREAT ); prio = 1;
-  fwrite( FILE, (uint8_t*)&entry_P2, 4 );
-  fwrite( FILE, (uint8_t*)&prio, 4 );
-  close( FILE );
+  return 0; // nothing else could run anyway
+}
 
-  FILE = open( "het", O_CREAT ); prio = 1;
-  fwrite( FILE, (uint8_t*)&entry_het, 4 );
-  fwrite( FILE, (uint8_t*)&prio, 4 );
-  close( FILE );
+// park the current process until the disk wakes it, then reissue its syscall
+void io_block( ctx_t* ctx ) {
+  ctx->pc -= 4; // back onto the svc instruction
 
-  FILE = open( "ping", O_CREAT ); prio = 1;
-  fwrite( FILE, (uint8_t*)&entry_ping, 4 );
-  fwrite( FILE, (uint8_t*)&prio, 4 );
-  close( FILE );
+  current->io_wait++;
+  current->io_block = 1;
+  kill( current->pid, SIGWAIT );
 
-  FILE = open( "pong", O_CREAT ); prio = 1;
-  fwrite( FILE, (uint8_t*)&entry_pong, 4 );
-  fwrite( FILE, (uint8_t*)&prio, 4 );
-  close( FILE );
+  scheduler( ctx );
+}
 
-  FILE = open( "blanks", O_CREAT ); prio = 1;
-  fwrite( FILE, (uint8_t*)&entry_blanks, 4 );
-  fwrite( FILE, (uint8_t*)&prio, 4 );
-  close( FILE );
-  
-  FILE = open( "hashs", O_CREAT ); prio = 1;
-  fwrite( FILE, (uint8_t*)&entry_hashs, 4 );
-  fwrite( FILE, (uint8_t*)&prio, 4 );
-  close( FILE );
+// wait for the disk: unwinds to the svc handler if the syscall can, else polls
+void iowait() {
+  if (io_async)
+    longjmp( io_jmp, 1 );
+
+  disk_drain();
 }
 
-// === BLOCK ALLOCATION FUNCTIONS ===
+// ====================
+// === BUFFER CACHE ===
+// ====================
 
-daddr32_t balloc() { // block allocation
-	if (fs.fs_fdbhead > 0) {
-		fs.fs_fdbhead--;
-    disk_wr( fs.fs_sblkno, (uint8_t*)(&fs), sizeof( fs_t ) ); // update sb
-		return fs.fs_fdb[ fs.fs_fdbhead+1 ];
-	}
-	
-	// block addr 1 is addr of superblock - indicates no space remaining
-	if (fs.fs_fdb[ fs.fs_fdbhead ] != 1) {
-		daddr32_t addr = fs.fs_fdb[ fs.fs_fdbhead ];
-    
-    uint8_t block[ BLOCK_SIZE ];
-    disk_rd( addr, block, BLOCK_SIZE );
+void bcache_init() {
+  disk_drain(); // nothing may still be read into the buffers
 
-    memcpy( fs.fs_fdb, block, 64 * sizeof( daddr32_t ) );
-    fs.fs_fdbhead = 63;
+  memset( bc,      0, sizeof( bc )      );
+  memset( bc_hash, 0, sizeof( bc_hash ) );
 
-    disk_wr( fs.fs_sblkno, (uint8_t*)(&fs), sizeof( fs_t ) ); // update sb
+  for (int i = 0; i < BCACHE_LIMIT; i++) {
+    bc[ i ].b_prev = i > 0                ? &bc[ i-1 ] : NULL;
+    bc[ i ].b_next = i < BCACHE_LIMIT - 1 ? &bc[ i+1 ] : NULL;
+  }
 
-		return addr;
-	}
+  bc_head = &bc[ 0 ];
+  bc_tail = &bc[ BCACHE_LIMIT - 1 ];
+}
 
-	return -1; // no more available blocks
+buf_t *blookup( daddr32_t a ) {
+  for (buf_t *b = bc_hash[ a % BCACHE_HASH ]; b != NULL; b = b->b_hash) {
+    if (b->b_addr == a)
+      return b;
+  }
+
+  return NULL; // not cached
 }
 
-int bfree( daddr32_t a ) { // block free
-	if (fs.fs_fdbhead < 63) {
-		fs.fs_fdb[ ++fs.fs_fdbhead ] = a;
-    disk_wr( fs.fs_sblkno, (uint8_t*)(&fs), sizeof( fs_t ) ); // update sb
-		return 0; // success
-	}
+void bunhash( buf_t *b ) {
+  buf_t **p = &bc_hash[ b->b_addr % BCACHE_HASH ];
 
-	disk_wr( a, (uint8_t*)fs.fs_fdb, 64 * sizeof( daddr32_t ) );
-	fs.fs_fdb[ 0 ] = a;
-	fs.fs_fdbhead  = 0;
-  disk_wr( fs.fs_sblkno, (uint8_t*)(&fs), sizeof( fs_t ) ); // update sb
+  while (*p != NULL && *p != b)
+    p = &(*p)->b_hash;
 
-	return 1; // success
-}
+  if (*p == b)
+    *p = b->b_hash;
 
-// === SUPERBLOCK FUNCTIONS ===
+  b->b_flags = 0;
+}
 
-void wipe() {
-  // superblock
-  fs.fs_sblkno  = 1;
-  fs.fs_size    = 2048;
-  fs.fs_iblkno  = 2;
-  fs.fs_isize   = 64*8;
-  fs.fs_dblkno  = 66;
-  fs.fs_dsize   = 1982;
-  fs.fs_fdbhead = (fs.fs_dsize%64)-1;
+// move buffer to head of LRU list
+void btouch( buf_t *b ) {
+  if (b == bc_head)
+    return;
 
-  daddr32_t fdb[ 64 ];
+  b->b_prev->b_next = b->b_next;
+  if (b == bc_tail) bc_tail         = b->b_prev;
+  else              b->b_next->b_prev = b->b_prev;
 
-  for (int i = 0; i < 30; i++) {
-    if (i == 29) 
-      fdb[ 0 ] = fs.fs_sblkno;
-    else
-      fdb[ 0 ] = i + 1 + fs.fs_dblkno;
+  b->b_prev = NULL;
+  b->b_next = bc_head;
+  bc_head->b_prev = b;
+  bc_head = b;
+}
 
-    for (int j = 0; j < 63; j++)
-      fdb[ j+1 ] = 63*i + j + (fs.fs_dblkno + 30);
+// claim the least recently used buffer for block a
+buf_t *bclaim( daddr32_t a ) {
+  buf_t *b = bc_tail;
 
-    disk_wr( i + fs.fs_dblkno, (uint8_t*)fdb, 64 * sizeof( daddr32_t ) );
-  }
+  // buffers still being read can't be reused
+  while (b != NULL && (b->b_flags & B_BUSY))
+    b = b->b_prev;
 
-  fs.fs_fdb[ 0 ] = fs.fs_dblkno;
-  for (int i = 1; i < 62; i++) {
-    fs.fs_fdb[ i ] = i + 1986; // 66 + 30 * 64
+  if (b == NULL) {
+    disk_drain();
+    b = bc_tail;
   }
 
-  disk_wr( fs.fs_sblkno, (uint8_t*)(&fs), sizeof( fs_t ) );
+  if (b->b_flags & B_AHEAD)
+    io_stats.ra_wasted++;
 
-  icommon_t ic[ 8 ]; 
-  for (int i = 0; i < 64; i++) {
-    disk_rd( i + fs.fs_iblkno, (uint8_t*)ic, 8 * sizeof( icommon_t ) );
-    for (int j = 0; j < 8; j++) {
-      if (i == 0 && j == ROOT_DIR) {
-        ic[ j ].ic_mode = IFDIR;
-        ic[ j ].ic_size = 32;
-        ic[ j ].ic_db[ 0 ] = balloc(); // note: this updates the disk
+  // write back dirty buffers together, rather than one per eviction
+  if (b->b_flags & B_DIRTY)
+    bsync();
 
-        dir_t dir[ 16 ];
-        dir[ 0 ].d_ino = ROOT_DIR;
-        dir[ 0 ].d_namlen = 1;
-        dir[ 0 ].d_name[ 0 ] = '.';
-
-        disk_wr( ic[ j ].ic_db[ 0 ], (uint8_t *)dir, 16 * sizeof( dir_t ) );        
-      }
-      else {
-        ic[ j ].ic_mode = IFZERO;
-        ic[ j ].ic_size = 0;
-      }
-    }
-    disk_wr( i + fs.fs_iblkno, (uint8_t *)ic, 8 * sizeof( icommon_t ) );
-  }  
+  if (b->b_flags & B_VALID)
+    bunhash( b );
 
-  createObjFiles();
+  b->b_addr  = a;
+  b->b_flags = B_VALID;
+  b->b_hash  = bc_hash[ a % BCACHE_HASH ];
+  bc_hash[ a % BCACHE_HASH ] = b;
 
-  return;
+  btouch( b );
+  return b;
 }
 
-// === DATA BLOCK FUNCTIONS ===
-
-int getDataBlockAddr( const inode_t *inode, uint32_t byte ) { 
-  int blk = byte / BLOCK_SIZE;
+buf_t *bfind( daddr32_t a ) {
+  buf_t *b = blookup( a );
 
-  // Direct block
-  if (blk < NDADDR) {
-    return (int)inode->i_ic.ic_db[ blk ];
+  // still being read: wait for it (it's gone again if the read failed)
+  if (b != NULL && (b->b_flags & B_BUSY)) {
+    iowait();
+    b = blookup( a );
   }
-  // Indirect blocks
-  else {
-    const int ls = BLOCK_SIZE/4;
-    uint8_t block[ BLOCK_SIZE ];
-
-    if      (blk < ls + NDADDR) {
-      blk -= NDADDR; 
-      disk_rd( inode->i_ic.ic_ib[ 0 ], block, BLOCK_SIZE );
-      return ((uint32_t*)block)[ blk ];
-    }
-    else if (blk < ls*ls + ls + NDADDR) {
-      blk -= ls + NDADDR;
-      disk_rd( inode->i_ic.ic_ib[ 1 ], block, BLOCK_SIZE );
-      disk_rd( ((uint32_t*)block)[ blk/ls ], block, BLOCK_SIZE );
-      return ((uint32_t*)block)[ blk%ls ];
-    }
-    else if (blk < ls*ls*ls + ls*ls + ls + NDADDR) {
-      blk -= ls*ls + ls + NDADDR;
-      disk_rd( inode->i_ic.ic_ib[ 2 ], block, BLOCK_SIZE );
-      disk_rd( ((uint32_t*)block)[ blk/(ls*ls) ], block, BLOCK_SIZE );
-      disk_rd( ((uint32_t*)block)[ (blk%(ls*ls))/ls ], block, BLOCK_SIZE );
-      return ((uint32_t*)block)[ blk%ls ];
-    }
-  } 
 
-  return -1;
+  return b;
 }
 
-int allocateDataBlockAddr( inode_t *inode, uint32_t byte ) { 
-  int blk = byte / BLOCK_SIZE;
-
-  int addr = balloc();
-  if (addr == -1)
-    return -1;
+void bfill( buf_t **b, int n, int w ) {
+  daddr32_t a[ BATCH_LIMIT ];
+  uint8_t  *x[ BATCH_LIMIT ];
 
-  // Direct block
-  if (blk < NDADDR) {
-    inode->i_ic.ic_db[ blk ] = addr;
-    writeInode( inode );
+  // in block address order, so the disk can merge them with other reads
+  for (int i = 0; i < n; i++) {
+    int j = i;
+    for (; j > 0 && a[ j-1 ] > b[ i ]->b_addr; j--) {
+      a[ j ] = a[ j-1 ]; x[ j ] = x[ j-1 ];
+    }
+    a[ j ] = b[ i ]->b_addr; x[ j ] = b[ i ]->b_data;
   }
-  // Indirect blocks
-  else {
-    const int ls = BLOCK_SIZE/4;
-    uint8_t block[ BLOCK_SIZE ];
-
-    int taddr;
 
-    if      (blk < ls + NDADDR) {
-      blk -= NDADDR; 
+  // read in the background if the syscall can wait for it (or needn't)
+  if (n > 0 && (io_async || !w) && disk_rdv_async( a, x, n, bdone ) != NULL) {
+    for (int i = 0; i < n; i++)
+      b[ i ]->b_flags |= B_BUSY;
 
-      if (blk == 0) {
-        taddr = balloc();
-        if (taddr == -1)
-          return -1;
-        inode->i_ic.ic_ib[ 0 ] = taddr;
-        writeInode( inode );
-      }
-      else {  
-        taddr = inode->i_ic.ic_ib[ 0 ];
-      }
+    if (!w)
+      return;
 
-      disk_rd( taddr, block, BLOCK_SIZE );
+    iowait();
+  }
 
-      ((uint32_t*)block)[ blk ] = addr;
-      disk_wr( taddr, block, BLOCK_SIZE );
-    }
-    else if (blk < ls*ls + ls + NDADDR) {
-      blk -= ls + NDADDR;
+  diskReadBlocks( a, x, n );
+}
 
-      if (blk == 0) {
-        taddr = balloc(); if (taddr == -1) return -1;
-        inode->i_ic.ic_ib[ 1 ] = taddr;
-        writeInode( inode );
-      }
-      else {  
-        taddr = inode->i_ic.ic_ib[ 1 ];
-      }
+// called by the disk driver (from the receive interrupt) once a background read completes
+void bdone( disk_req_t *r ) {
+  for (int i = 0; i < r->n; i++) {
+    buf_t *b = (buf_t*)(r->x[ i ] - offsetof( buf_t, b_data ));
 
-      disk_rd( taddr, block, BLOCK_SIZE );
+    b->b_flags &= ~B_BUSY;
+    if (r->status != 0)
+      bunhash( b ); // failed: forget it, so it's read again
+  }
 
-      if (blk % ls == 0) {
-        taddr = balloc(); if (taddr == -1) return -1;
-        ((uint32_t*)block)[ blk/ls ] = taddr;
-        disk_wr( taddr, block, BLOCK_SIZE );
-      }
-      else {
-        taddr = ((uint32_t*)block)[ blk/ls ];
-      }
-  
-      disk_rd( taddr, block, BLOCK_SIZE );
+  aio_due = 1; // asynchronous requests may be waiting on these
 
-      ((uint32_t*)block)[ blk%ls ] = addr;
-      disk_wr( taddr, block, BLOCK_SIZE );
+  // wake everyone waiting on the disk: each reissues its syscall, and waits again if need be
+  for (pid_t p = 0; p < PROCESS_LIMIT; p++) {
+    if (pcb[ p ].io_block) {
+      pcb[ p ].io_block = 0;
+      kill( p, SIGCONT );
     }
-    else if (blk < ls*ls*ls + ls*ls + ls + NDADDR) {
-      blk -= ls*ls + ls + NDADDR;
+  }
+}
 
-      if (blk == 0) {
-        taddr = balloc(); if (taddr == -1) return -1;
-        inode->i_ic.ic_ib[ 2 ] = taddr;
-        writeInode( inode );
-      }
-      else {  
-        taddr = inode->i_ic.ic_ib[ 2 ];
-      }
+// cache hit on buffer b
+void bhit( buf_t *b ) {
+  io_stats.bc_hits++;
 
-      disk_rd( taddr, block, BLOCK_SIZE );
+  if (b->b_flags & B_AHEAD) {
+    io_stats.ra_hits++;
+    b->b_flags &= ~B_AHEAD;
+  }
 
-      if (blk % (ls*ls) == 0) {
-        taddr = balloc(); if (taddr == -1) return -1;
-        ((uint32_t*)block)[ blk/(ls*ls) ] = taddr;
-        disk_wr( taddr, block, BLOCK_SIZE );
-      }
-      else {
-        taddr = ((uint32_t*)block)[ blk/(ls*ls) ];
-      }
-  
-      disk_rd( taddr, block, BLOCK_SIZE );
+  btouch( b );
+}
 
-      blk %= ls*ls;
+buf_t *bread( daddr32_t a ) {
+  buf_t *b = bfind( a );
 
-      if (blk % ls == 0) {
-        taddr = balloc(); if (taddr == -1) return -1;
-        ((uint32_t*)block)[ blk/ls ] = taddr;
-        disk_wr( taddr, block, BLOCK_SIZE );
-      }
-      else {
-        taddr = ((uint32_t*)block)[ blk/ls ];
-      }
-  
-      disk_rd( taddr, block, BLOCK_SIZE );
+  if (b != NULL) {
+    bhit( b );
+    return b;
+  }
 
-      ((uint32_t*)block)[ blk%ls ] = addr;
-      disk_wr( taddr, block, BLOCK_SIZE );
-    }
-  } 
+  io_stats.bc_misses++;
+  b = bclaim( a );
+  bfill( &b, 1, 1 );
 
-  return addr;
+  return b;
 }
 
-int allocateDataBlocks( inode_t *inode, uint32_t bytes ) {
-  const int b = inode->i_ic.ic_size / BLOCK_SIZE;
-  const int n = (inode->i_ic.ic_size + bytes) / BLOCK_SIZE;
+buf_t *bget( daddr32_t a ) {
+  buf_t *b = bfind( a );
 
-  for (int i = b+1; i <= n; i++) { 
-    if (allocateDataBlockAddr( inode, i * BLOCK_SIZE ) == -1) 
-      return -1;
+  if (b != NULL) {
+    btouch( b );
+    return b;
   }
 
-  return inode->i_ic.ic_size += bytes;
+  return bclaim( a );
 }
 
-int freeDataBlocks( inode_t *inode ) {
-  for (int i = 0; i < inode->i_ic.ic_size; i += BLOCK_SIZE) { 
-    // Removing direct or leaf blocks    
-    bfree( getDataBlockAddr( inode, i ) );
-
-    // Removing indirect blocks
-    int blk = i / BLOCK_SIZE;
-    if (blk >= NDADDR) {
-      const int ls = BLOCK_SIZE/4;
-      uint8_t block[ BLOCK_SIZE ];
+void bdirty( buf_t *b ) {
+  b->b_flags |= B_DIRTY;
+}
 
-      if      (blk < ls + NDADDR) {
-        blk -= NDADDR;
-        if (blk == 0) {
-          bfree( inode->i_ic.ic_ib[ 0 ] );
-        }
+int bsync() {
+  daddr32_t a[ BCACHE_LIMIT ];
+  const uint8_t *x[ BCACHE_LIMIT ];
+  int n = 0;
+
+  // gather dirty buffers in block address order, so runs can be written together
+  for (int i = 0; i < BCACHE_LIMIT; i++) {
+    if ((bc[ i ].b_flags & (B_VALID | B_DIRTY)) == (B_VALID | B_DIRTY)) {
+      int j = n++;
+      for (; j > 0 && a[ j-1 ] > bc[ i ].b_addr; j--) {
+        a[ j ] = a[ j-1 ]; x[ j ] = x[ j-1 ];
       }
-      else if (blk < ls*ls + ls + NDADDR) {
-        blk -= ls + NDADDR;
+      a[ j ] = bc[ i ].b_addr; x[ j ] = bc[ i ].b_data;
 
-        disk_rd( inode->i_ic.ic_ib[ 1 ], block, BLOCK_SIZE );
+      bc[ i ].b_flags &= ~B_DIRTY;
+    }
+  }
 
-        if (blk % ls == 0) {
-          bfree( ((uint32_t*)block)[ blk/ls ] );
-        }
+  diskWriteBlocks( a, x, n );
+  io_stats.bc_writebacks += n;
 
-        if (blk == 0) {
-          bfree( inode->i_ic.ic_ib[ 1 ] );
-        }
-      }
-      else if (blk < ls*ls*ls + ls*ls + ls + NDADDR) {
-        blk -= ls*ls + ls + NDADDR;
+  return n;
+}
 
-        disk_rd( inode->i_ic.ic_ib[ 2 ], block, BLOCK_SIZE );
-        disk_rd( ((uint32_t*)block)[ blk / (ls*ls) ], block, BLOCK_SIZE );
+void bcache_rd( daddr32_t a,       uint8_t *x, int n ) {
+  memcpy( x, bread( a )->b_data, n );
+}
 
-        if ((blk % (ls*ls)) % ls == 0) {
-          bfree( ((uint32_t*)block)[ (blk % (ls*ls))/ls ] );
-        }
+void bcache_wr( daddr32_t a, const uint8_t *x, int n ) {
+  buf_t *b = n == BLOCK_SIZE ? bget( a ) : bread( a );
 
-        disk_rd( inode->i_ic.ic_ib[ 2 ], block, BLOCK_SIZE );
+  memcpy( b->b_data, x, n );
+  bdirty( b );
+}
 
-        if (blk % (ls*ls) == 0) {
-          bfree( ((uint32_t*)block)[ blk/(ls*ls) ] );
-        }
+// read n blocks, block x[ i ] from address a[ i ], in as few disk requests as possible
+void diskReadBlocks( const daddr32_t *a, uint8_t * const *x, int n ) {
+  for (int i = 0; i < n; i += BATCH_LIMIT) {
+    const int m = n - i > BATCH_LIMIT ? BATCH_LIMIT : n - i;
 
-        if (blk == 0) {
-          bfree( inode->i_ic.ic_ib[ 2 ] );
-        }
-      }
+    // a run of consecutive blocks into a contiguous buffer needs no address list
+    int run = 1;
+    for (int j = 1; j < m && run; j++) {
+      run = a[ i+j ] == a[ i ] + j && x[ i+j ] == x[ i ] + j * BLOCK_SIZE;
     }
-  }
 
-  return 0;
-}
-
-int getDataBlock( uint8_t *block, const inode_t *inode, uint32_t byte ) { 
-  int addr = getDataBlockAddr( inode, byte );
-  disk_rd( addr, block, BLOCK_SIZE );
-  return addr;
+    if (m == 1)   disk_rd( a[ i ], x[ i ], BLOCK_SIZE );
+    else if (run) disk_rdn( a[ i ], x[ i ], m );
+    else          disk_rdv( &a[ i ], &x[ i ], m );
+  }
 }
 
-// === INODE FUNCTIONS ===
-
-inode_t *copyInode( inode_t *copy, inode_t *inode ) {
-  if (getFreeInode( copy ) == NULL)
-    return NULL;
-  allocateDataBlocks( copy, (inode->i_ic.ic_size / BLOCK_SIZE) + 1 );
+// write n blocks, block x[ i ] to address a[ i ], in as few disk requests as possible
+void diskWriteBlocks( const daddr32_t *a, const uint8_t * const *x, int n ) {
+  for (int i = 0; i < n; i += BATCH_LIMIT) {
+    const int m = n - i > BATCH_LIMIT ? BATCH_LIMIT : n - i;
 
-  uint8_t block[ BLOCK_SIZE ];
+    // a run of consecutive blocks from a contiguous buffer needs no address list
+    int run = 1;
+    for (int j = 1; j < m && run; j++) {
+      run = a[ i+j ] == a[ i ] + j && x[ i+j ] == x[ i ] + j * BLOCK_SIZE;
+    }
 
-  for (int i = 0; i < inode->i_ic.ic_size; i += BLOCK_SIZE) { 
-    getDataBlock( block, inode, i );
-    int n = inode->i_ic.ic_size - i > BLOCK_SIZE ? BLOCK_SIZE : inode->i_ic.ic_size - i;
-    disk_wr( getDataBlockAddr( copy, i ), block, n );
+    if (m == 1)   disk_wr( a[ i ], x[ i ], BLOCK_SIZE );
+    else if (run) disk_wrn( a[ i ], x[ i ], m );
+    else          disk_wrv( &a[ i ], &x[ i ], m );
   }
-
-  return copy;
 }
 
-inode_t *readInode( inode_t *in, int ino ) {
-	// TODO: validation in case ino is invalid
+// buffers holding blocks a[ i ] (n at most BATCH_LIMIT), fetching all misses in one go; a hole (0) gets bc_hole
+void breadn( const daddr32_t *a, buf_t **b, int n ) {
+  buf_t *mb[ BATCH_LIMIT ]; // missed buffers
+  int    k = 0;
 
-	int q = ino / 8;
-	int r = ino % 8;
-	
-	icommon_t ic[ 8 ];
-	disk_rd( fs.fs_iblkno + q, (uint8_t*)ic, 8 * sizeof( icommon_t ) );
+  // wait out any being read before claiming buffers, as waiting may unwind the syscall (holes read as zeroes)
+  for (int j = 0; j < n; j++) {
+    b[ j ] = a[ j ] == 0 ? &bc_hole : bfind( a[ j ] );
+  }
+
+  // every hit is moved to the head of the LRU list before any miss claims a buffer, so none is claimed from under us
+  for (int j = 0; j < n; j++) {
+    if (b[ j ] != &bc_hole && (b[ j ] != NULL || (b[ j ] = blookup( a[ j ] )) != NULL))
+      bhit( b[ j ] );
+  }
 
-	in->i_number = ino;
-	in->i_ic		 = ic[ r ];
+  for (int j = 0; j < n; j++) {
+    if (b[ j ] == NULL && (b[ j ] = blookup( a[ j ] )) == NULL) {
+      io_stats.bc_misses++;
+      b[ j ] = mb[ k++ ] = bclaim( a[ j ] );
+    }
+  }
 
-	return in;
+  bfill( mb, k, 1 );
 }
 
-inode_t *writeInode( inode_t *inode ) {
-  const int q = inode->i_number / 8;
-	const int r = inode->i_number % 8;
-	
-	icommon_t ic[ 8 ];
-	disk_rd( fs.fs_iblkno + q, (uint8_t*)ic, BLOCK_SIZE );
-
-  ic[ r ] = inode->i_ic;
-  disk_wr( fs.fs_iblkno + q, (uint8_t*)ic, BLOCK_SIZE );
-	
-	return inode;
-} 
+// read n blocks via the cache, block x[ i ] from address a[ i ], fetching all misses in one go
+void readBlocks( const daddr32_t *a, uint8_t * const *x, int n ) {
+  for (int i = 0; i < n; i += BATCH_LIMIT) {
+    const int m = n - i > BATCH_LIMIT ? BATCH_LIMIT : n - i;
 
-inode_t * getFreeInode( inode_t *in ) {
-	icommon_t ic[ 8 ];
-	for (int i = 0; i < fs.fs_isize/8; i++) {
-		disk_rd( fs.fs_iblkno + i, (uint8_t*)ic, 8 * sizeof( icommon_t ) );
-		for (int j = 0; j < 8; j++) {
-			if (ic[ j ].ic_mode == IFZERO) { // inode unused
-				in->i_number     = 8*i + j;
-        in->i_ic.ic_mode = IFREG;
-        in->i_ic.ic_size = 0;
-				return in;
-			}
-		}
-	}
+    buf_t *b[ BATCH_LIMIT ];
+    breadn( &a[ i ], b, m );
 
-	return NULL;
+    for (int j = 0; j < m; j++) {
+      memcpy( x[ i+j ], b[ j ]->b_data, BLOCK_SIZE );
+    }
+  }
 }
 
-dir_t *getLastDir( dir_t *d, const inode_t *inode ) {
-  const int r = ((inode->i_ic.ic_size / 32) - 1) % 16; // offset of last dir, assumes directory non-empty
-  
-  dir_t dir[ 16 ];
-  getDataBlock( (uint8_t*)dir, inode, inode->i_ic.ic_size - 32);
+// fetch (up to BATCH_LIMIT) blocks into the cache without waiting for them, if the disk allows;
+// blocks from a[ k ] on are counted as read ahead
+void prefetchBlocks( const daddr32_t *a, int n, int k ) {
+  buf_t *mb[ BATCH_LIMIT ];
+  int    m = 0;
+
+  for (int i = 0; i < n && m < BATCH_LIMIT; i++) {
+    if (a[ i ] != 0 && blookup( a[ i ] ) == NULL) {
+      mb[ m ] = bclaim( a[ i ] );
+      if (i >= k)
+        mb[ m ]->b_flags |= B_AHEAD;
+      m++;
+    }
+  }
 
-  memcpy( d, &dir[ r ], sizeof( dir_t ) );
-  return d;
+  bfill( mb, m, 0 );
 }
 
-int removable( inode_t *parent, dir_t *child ) {
-  // check removing current directory
-  if (child->d_ino == cwd)
-    return -1;
-
-  // inode already in AIT
-  for (int i = 0; i < AIT_LIMIT; i++) {
-    if (ai[ i ].i_number == child->d_ino && ai[ i ].i_ic.ic_mode != IFZERO)
-      return -1;
-  }	
-
-  // check for non-empty directory
-  inode_t inode;
-  readInode( &inode, child->d_ino );
+// write n blocks via the cache, block x[ i ] to address a[ i ] (written back later)
+void writeBlocks( const daddr32_t *a, const uint8_t * const *x, int n ) {
+  for (int i = 0; i < n; i++) {
+    buf_t *b = bget( a[ i ] );
 
-  if (inode.i_ic.ic_mode == IFDIR && inode.i_ic.ic_size > 64) {
-    return -1; // more entries than just . and ..
+    memcpy( b->b_data, x[ i ], BLOCK_SIZE );
+    bdirty( b );
   }
-
-  return child->d_ino;
 }
 
-int remove( dir_t *child, inode_t *parent, const char *name ) {
-	const int bytes = parent->i_ic.ic_size; // number of bytes
-	const int dirs  = bytes / 32;       // number of directories
+// copy n blocks, block s[ i ] (zeroes, if it's a hole) to address d[ i ], having the disk copy them where it can
+void copyBlocks( const daddr32_t *s, const daddr32_t *d, int n ) {
+  uint32_t rs[ DISK_COPY_LIMIT ], rd[ DISK_COPY_LIMIT ], rn[ DISK_COPY_LIMIT ];
 
-  if (dirs > 0) {
-	  const int blks  = ((dirs-1) / 16) + 1;	// number of blocks
-	  const int r		  = dirs % 16;			      // offset in last block
-	
-	  dir_t dir[ 16 ];
-    daddr32_t addr;
+  bsync(); // the disk must hold what's copied, and nothing cached may be written over the copies later
 
-    // TODO: check file exists in ai, and prevent removal if so : "error, do not have permission to remove."
+  for (int i = 0, k; i < n; i = k) {
+    int m = 0;
 
-	  for (int i = 0; i < blks-1; i++) {
-      addr = getDataBlock( (uint8_t*)dir, parent, BLOCK_SIZE * i );
-		  for (int j = 0; j < 16; j++) {
-			  if (strncmp( name, dir[j].d_name, dir[j].d_namlen >= strlen(name) ? dir[j].d_namlen : strlen(name) ) == 0) {
-          if (removable( parent, &dir[ j ] ) != -1) {          
-            memcpy( child, &dir[ j ], sizeof( dir_t ) );        
+    // runs of consecutive blocks going to consecutive blocks, bar holes
+    for (k = i; k < n; k++) {
+      if (s[ k ] == 0)
+        continue;
 
-            getLastDir( &dir[ j ], parent ); 
-            disk_wr( addr, (uint8_t*)dir, BLOCK_SIZE );
+      if (m > 0 && s[ k ] == rs[ m-1 ] + rn[ m-1 ] && d[ k ] == rd[ m-1 ] + rn[ m-1 ])
+        rn[ m-1 ]++;
+      else if (m == DISK_COPY_LIMIT)
+        break;
+      else {
+        rs[ m ] = s[ k ]; rd[ m ] = d[ k ]; rn[ m++ ] = 1;
+      }
+    }
 
-            parent->i_ic.ic_size -= 32;
-            writeInode( parent );
+    if (m > 0 && disk_copy( rs, rd, rn, m ) == 0) {
+      for (int j = i; j < k; j++) {
+        buf_t *b = s[ j ] == 0 ? bget( d[ j ] ) : blookup( d[ j ] );
 
-				    return child->d_ino;
-          }
+        if (s[ j ] == 0) {
+          memset( b->b_data, 0, BLOCK_SIZE );
+          bdirty( b );
         }
-		  }
-	  }
-
-    addr = getDataBlock( (uint8_t*)dir, parent, BLOCK_SIZE * (blks-1) );
-	  for (int j = 0; j < r; j++) {
-		  if (strncmp( name, dir[j].d_name, dir[j].d_namlen >= strlen(name) ? dir[j].d_namlen : strlen(name) ) == 0) {
-        if (removable( parent, &dir[ j ] ) != -1) { 
-          memcpy( child, &dir[ j ], sizeof( dir_t ) );       
-
-          getLastDir( &dir[ j ], parent ); 
-          disk_wr( addr, (uint8_t*)dir, BLOCK_SIZE );
-          
-          parent->i_ic.ic_size -= 32;
-          writeInode( parent );  
-
-			    return child->d_ino;
+        else {
+          io_stats.io_copied++;
+          if (b != NULL)
+            bunhash( b ); // stale
         }
       }
-	  }
-  }
 
-	return -1; // does not exist in directory
-}
+      continue;
+    }
 
-int name_to_ino( const char *name, const inode_t *in ) {
-	const int bytes = in->i_ic.ic_size; // number of bytes
-	const int dirs  = bytes / 32;       // number of directories
+    // the disk can't: through the cache, a batch at a time
+    for (int j = i; j < k; j += BATCH_LIMIT) {
+      const int c = k - j > BATCH_LIMIT ? BATCH_LIMIT : k - j;
+      buf_t    *b[ BATCH_LIMIT ];
 
-  if (dirs > 0) {
-	  const int blks  = ((dirs-1) / 16) + 1;	// number of blocks
-	  const int r		  = dirs % 16;			      // offset in last block
+      breadn( &s[ j ], b, c );
+
+      for (int l = 0; l < c; l++) {
+        buf_t *t = bget( d[ j+l ] );
+
+        memcpy( t->b_data, b[ l ]->b_data, BLOCK_SIZE );
+        bdirty( t );
+      }
+    }
+  }
+}
+
+// ===================
+// === INODE CACHE ===
+// ===================
+
+/* Every inode read or written goes via the inode cache, so path lookups
+ * and open files share one in-core copy, found by hashing its number.
+ * Open files hold a reference (i_links) to theirs, and writeInode only
+ * marks an entry dirty: it's copied into its inode block by isync, or
+ * once evicted. Unreferenced entries stay cached until their slot is
+ * needed, least recently used first, bar the root and the working
+ * directory, which almost every lookup starts from.
+ */
+
+void icache_init() {
+  memset( icache,      0, sizeof( icache )      );
+  memset( icache_hash, 0, sizeof( icache_hash ) );
+
+  for (int i = 0; i < ICACHE_LIMIT; i++) {
+    icache[ i ].i_prev = i > 0                ? &icache[ i-1 ] : NULL;
+    icache[ i ].i_next = i < ICACHE_LIMIT - 1 ? &icache[ i+1 ] : NULL;
+  }
+
+  icache_head = &icache[ 0 ];
+  icache_tail = &icache[ ICACHE_LIMIT - 1 ];
+}
+
+inode_t *ilookup( uint32_t ino ) {
+  for (inode_t *in = icache_hash[ ino % ICACHE_HASH ]; in != NULL; in = in->i_hash) {
+    if (in->i_number == ino)
+      return in;
+  }
+
+  return NULL; // not cached
+}
+
+void iunhash( inode_t *inode ) {
+  inode_t **p = &icache_hash[ inode->i_number % ICACHE_HASH ];
+
+  while (*p != NULL && *p != inode)
+    p = &(*p)->i_hash;
+
+  if (*p == inode)
+    *p = inode->i_hash;
+
+  inode->i_flags = 0;
+}
+
+// move inode to head of LRU list
+void itouch( inode_t *inode ) {
+  if (inode == icache_head)
+    return;
+
+  inode->i_prev->i_next = inode->i_next;
+  if (inode == icache_tail) icache_tail           = inode->i_prev;
+  else                      inode->i_next->i_prev = inode->i_prev;
+
+  inode->i_prev = NULL;
+  inode->i_next = icache_head;
+  icache_head->i_prev = inode;
+  icache_head = inode;
+}
+
+void iflush( inode_t *inode ) {
+  buf_t *b = bread( fs.fs_iblkno + inode->i_number / 8 );
+
+  ((icommon_t*)b->b_data)[ inode->i_number % 8 ] = inode->i_ic;
+  bdirty( b );
+
+  inode->i_flags &= ~I_DIRTY;
+}
+
+void isync() {
+  for (int i = 0; i < ICACHE_LIMIT; i++) {
+    // open files change in place, without being marked dirty each time
+    if ((icache[ i ].i_flags & I_VALID) && ((icache[ i ].i_flags & I_DIRTY) || icache[ i ].i_links > 0))
+      iflush( &icache[ i ] );
+  }
+}
+
+inode_t *iget( uint32_t ino ) {
+  inode_t *in = ilookup( ino );
+
+  if (in != NULL) {
+    itouch( in );
+    return in;
+  }
+
+  // least recently used entry no file holds open
+  for (in = icache_tail; in != NULL; in = in->i_prev) {
+    if (in->i_links == 0 && !((in->i_flags & I_VALID) && (in->i_number == ROOT_DIR || in->i_number == cwd)))
+      break;
+  }
+
+  if (in == NULL)
+    return NULL; // table full
+
+  // both may wait on the disk (and so restart the syscall), so go before the entry changes
+  if (in->i_flags & I_DIRTY)
+    iflush( in );
+
+  const icommon_t *ic = (icommon_t*)bread( fs.fs_iblkno + ino / 8 )->b_data;
+
+  if (in->i_flags & I_VALID)
+    iunhash( in );
+
+  in->i_number = ino;
+  in->i_ic     = ic[ ino % 8 ];
+  in->i_flags  = I_VALID;
+  in->i_hash   = icache_hash[ ino % ICACHE_HASH ];
+  icache_hash[ ino % ICACHE_HASH ] = in;
+
+  itouch( in );
+  return in;
+}
+
+// ====================
+// === DENTRY CACHE ===
+// ====================
+
+/* Path lookups remember what each name they looked up in a directory
+ * mapped to, found by hashing the directory's inode number and the name,
+ * so walking a hot path takes neither an inode nor a directory block.
+ * Names found in no entry are cached too (negative dentries), so e.g.
+ * each open( O_CREAT ) of a new file needn't scan its directory twice.
+ * Anything adding or removing an entry forgets that name in that
+ * directory, and once a directory is unlinked every name cached in it
+ * goes, as its inode number may be reused; recent lookups stay cached
+ * until their entry is needed, least recently used first.
+ */
+
+void dcache_init() {
+  memset( dcache,      0, sizeof( dcache )      );
+  memset( dcache_hash, 0, sizeof( dcache_hash ) );
+
+  for (int i = 0; i < DCACHE_LIMIT; i++) {
+    dcache[ i ].de_prev = i > 0                ? &dcache[ i-1 ] : NULL;
+    dcache[ i ].de_next = i < DCACHE_LIMIT - 1 ? &dcache[ i+1 ] : NULL;
+  }
+
+  dcache_head = &dcache[ 0 ];
+  dcache_tail = &dcache[ DCACHE_LIMIT - 1 ];
+}
+
+dentry_t **dchain( uint32_t dir, const char *name, int len ) {
+  return &dcache_hash[ (dirHash( name, len ) ^ dir) % DCACHE_HASH ];
+}
+
+dentry_t *dfind( uint32_t dir, const char *name, int len ) {
+  for (dentry_t *de = *dchain( dir, name, len ); de != NULL; de = de->de_hash) {
+    if (de->de_dir == dir && de->de_namlen == len && strncmp( de->de_name, name, len ) == 0)
+      return de;
+  }
+
+  return NULL; // not cached
+}
+
+void dunhash( dentry_t *de ) {
+  dentry_t **p = dchain( de->de_dir, de->de_name, de->de_namlen );
+
+  while (*p != NULL && *p != de)
+    p = &(*p)->de_hash;
+
+  if (*p == de)
+    *p = de->de_hash;
+
+  de->de_namlen = 0;
+}
+
+// move dentry to head of LRU list (or, iff. tail, to its tail)
+void dtouch( dentry_t *de, int tail ) {
+  if (de == (tail ? dcache_tail : dcache_head))
+    return;
+
+  if (de == dcache_head) dcache_head          = de->de_next;
+  else                   de->de_prev->de_next = de->de_next;
+  if (de == dcache_tail) dcache_tail          = de->de_prev;
+  else                   de->de_next->de_prev = de->de_prev;
+
+  if (tail) {
+    de->de_next = NULL;
+    de->de_prev = dcache_tail;
+    dcache_tail->de_next = de;
+    dcache_tail = de;
+  }
+  else {
+    de->de_prev = NULL;
+    de->de_next = dcache_head;
+    dcache_head->de_prev = de;
+    dcache_head = de;
+  }
+}
+
+int dlookup( uint32_t dir, const char *name, int len ) {
+  dentry_t *de = dfind( dir, name, len );
+
+  if (de == NULL) {
+    io_stats.dc_misses++;
+    return -2;
+  }
+
+  io_stats.dc_hits++;
+  dtouch( de, 0 );
+  return de->de_ino;
+}
+
+void denter( uint32_t dir, const char *name, int len, int ino ) {
+  if (len == 0 || len > MAXNAMLEN)
+    return; // can't be held
+
+  dentry_t *de = dfind( dir, name, len );
+
+  if (de == NULL) {
+    de = dcache_tail;
+    if (de->de_namlen != 0)
+      dunhash( de );
+
+    de->de_dir    = dir;
+    de->de_namlen = len;
+    memcpy( de->de_name, name, len );
+
+    dentry_t **p = dchain( dir, name, len );
+    de->de_hash = *p;
+    *p = de;
+  }
+
+  de->de_ino = ino;
+  dtouch( de, 0 );
+}
+
+void dforget( uint32_t dir, const char *name, int len ) {
+  dentry_t *de = dfind( dir, name, len );
+
+  if (de != NULL) {
+    dunhash( de );
+    dtouch( de, 1 ); // reused first
+  }
+}
+
+void dpurge( uint32_t dir ) {
+  for (int i = 0; i < DCACHE_LIMIT; i++) {
+    if (dcache[ i ].de_namlen != 0 && dcache[ i ].de_dir == dir) {
+      dunhash( &dcache[ i ] );
+      dtouch( &dcache[ i ], 1 );
+    }
+  }
+}
+
+// ==================
+// === FILESYSTEM ===
+// ==================
+
+void createObjFiles() {
+  int FILE; int prio;
+
+  FILE = open( "P0", O_CREAT ); prio = 1;
+  fwrite( FILE, (uint8_t*)&entry_P0, 4 );
+  fwrite( FILE, (uint8_t*)&prio, 4 );
+  close( FILE );
+
+  FILE = open( "P1", O_CREAT ); prio = 1;
+  fwrite( FILE, (uint8_t*)&entry_P1, 4 );
+  fwrite( FILE, (uint8_t*)&prio, 4 );
+  close( FILE );
+
+  FILE = open( "P2", O_CREAT ); prio = 1;
+  fwrite( FILE, (uint8_t*)&entry_P2, 4 );
+  fwrite( FILE, (uint8_t*)&prio, 4 );
+  close( FILE );
+
+  FILE = open( "het", O_CREAT ); prio = 1;
+  fwrite( FILE, (uint8_t*)&entry_het, 4 );
+  fwrite( FILE, (uint8_t*)&prio, 4 );
+  close( FILE );
+
+  FILE = open( "ping", O_CREAT ); prio = 1;
+  fwrite( FILE, (uint8_t*)&entry_ping, 4 );
+  fwrite( FILE, (uint8_t*)&prio, 4 );
+  close( FILE );
+
+  FILE = open( "pong", O_CREAT ); prio = 1;
+  fwrite( FILE, (uint8_t*)&entry_pong, 4 );
+  fwrite( FILE, (uint8_t*)&prio, 4 );
+  close( FILE );
+
+  FILE = open( "blanks", O_CREAT ); prio = 1;
+  fwrite( FILE, (uint8_t*)&entry_blanks, 4 );
+  fwrite( FILE, (uint8_t*)&prio, 4 );
+  close( FILE );
+  
+  FILE = open( "hashs", O_CREAT ); prio = 1;
+  fwrite( FILE, (uint8_t*)&entry_hashs, 4 );
+  fwrite( FILE, (uint8_t*)&prio, 4 );
+  close( FILE );
+
+  FILE = open( "fsbench", O_CREAT ); prio = 1;
+  fwrite( FILE, (uint8_t*)&entry_fsbench, 4 );
+  fwrite( FILE, (uint8_t*)&prio, 4 );
+  close( FILE );
+
+  FILE = open( "dirbench", O_CREAT ); prio = 1;
+  fwrite( FILE, (uint8_t*)&entry_dirbench, 4 );
+  fwrite( FILE, (uint8_t*)&prio, 4 );
+  close( FILE );
+
+  FILE = open( "iobench", O_CREAT ); prio = 1;
+  fwrite( FILE, (uint8_t*)&entry_iobench, 4 );
+  fwrite( FILE, (uint8_t*)&prio, 4 );
+  close( FILE );
+}
+
+// === BLOCK ALLOCATION FUNCTIONS ===
+
+daddr32_t balloc() { // block allocation
+  if (fs.fs_alloc != FS_LIST) {
+    daddr32_t a;
+    return ballocRun( 0, 1, &a ) == -1 ? -1 : a;
+  }
+
+  io_stats.al_probes++;
+
+	if (fs.fs_fdbhead > 0) {
+		fs.fs_fdbhead--;
+    io_stats.al_blocks++;
+    sbdirty();
+		return fs.fs_fdb[ fs.fs_fdbhead+1 ];
+	}
+	
+	// block addr 1 is addr of superblock - indicates no space remaining
+	if (fs.fs_fdb[ fs.fs_fdbhead ] != 1) {
+		daddr32_t addr = fs.fs_fdb[ fs.fs_fdbhead ];
+    
+    uint8_t block[ BLOCK_SIZE ];
+    bcache_rd( addr, block, BLOCK_SIZE );
+    io_stats.al_refills++;
+
+    memcpy( fs.fs_fdb, block, 64 * sizeof( daddr32_t ) );
+    fs.fs_fdbhead = 63;
+
+    io_stats.al_blocks++;
+    sbdirty();
+
+		return addr;
+	}
+
+	return -1; // no more available blocks
+}
+
+/* Allocating from the back of the in-core list hands out whatever was
+ * freed last, so extent mapped files ask for the block after their last
+ * one (goal) instead: if it's in the in-core list it's swapped to the
+ * back, else the lowest address there that starts a run (i.e., whose
+ * successor is listed too), so the file can keep growing from it.
+ */
+daddr32_t ballocNear( daddr32_t goal ) {
+  if (fs.fs_alloc != FS_LIST) {
+    daddr32_t a;
+    return ballocRun( goal, 1, &a ) == -1 ? -1 : a;
+  }
+
+  int best = fs.fs_fdbhead, run = 0;
+
+  for (int i = 1; i <= fs.fs_fdbhead; i++) {
+    const daddr32_t a = fs.fs_fdb[ i ];
+    io_stats.al_probes++;
+
+    if (a == goal) {
+      best = i;
+      break;
+    }
+
+    int r = 0;
+    for (int j = 1; j <= fs.fs_fdbhead && !r; j++)
+      r = fs.fs_fdb[ j ] == a + 1;
+
+    if (r > run || (r == run && a < fs.fs_fdb[ best ])) {
+      best = i;
+      run  = r;
+    }
+  }
+
+  const daddr32_t a = fs.fs_fdb[ best ];
+  fs.fs_fdb[ best ] = fs.fs_fdb[ fs.fs_fdbhead ];
+  fs.fs_fdb[ fs.fs_fdbhead ] = a;
+
+  return balloc();
+}
+
+/* A disk formatted with a free-space bitmap (see wipe) keeps one bit per
+ * block, all held in memory (fs_bmap) and written back along with the
+ * superblock. That allows allocating a whole run of blocks at once:
+ * from the goal if it's free (so a file grows in place), else from the
+ * run the policy picks, i.e., the first run long enough from where the
+ * last allocation ended (FS_NEXTFIT), or the shortest run long enough
+ * (FS_BESTFIT); if none is, the longest run there is.
+ */
+
+#define BMAP_USED( a ) ( fs_bmap[ (a) / 8 ] & ( 1 << ((a) % 8) ) )
+
+// scan blocks [lo, hi) for free runs, keeping the one preferred for n blocks in *a, *len; returns 1 once it can't be bettered
+int bmapScan( daddr32_t lo, daddr32_t hi, int n, daddr32_t *a, int *len ) {
+  for (daddr32_t b = lo; b < hi; ) {
+    io_stats.al_probes++;
+
+    // skip used blocks a byte at a time where possible
+    if (b % 8 == 0 && b + 8 <= hi && fs_bmap[ b / 8 ] == 0xFF) {
+      b += 8;
+      continue;
+    }
+    if (BMAP_USED( b )) {
+      b++;
+      continue;
+    }
+
+    // how long the run is (next-fit only needs to know it's at least n, as it then stops here)
+    daddr32_t e = b + 1, cap = hi;
+    if (fs.fs_alloc == FS_NEXTFIT && b + n < hi)
+      cap = b + n;
+
+    while (e < cap && !BMAP_USED( e )) {
+      io_stats.al_probes++;
+      e += e % 8 == 0 && e + 8 <= cap && fs_bmap[ e / 8 ] == 0x00 ? 8 : 1;
+    }
+
+    const int r = e - b;
+    if (*len < n ? r > *len : fs.fs_alloc == FS_BESTFIT && r >= n && r < *len) {
+      *a   = b;
+      *len = r;
+    }
+    if (*len >= n && (fs.fs_alloc == FS_NEXTFIT || *len == n))
+      return 1;
+
+    b = e;
+  }
+
+  return 0;
+}
+
+// allocate a run of (up to) n consecutive blocks, starting at the goal if free: returns its length, and its address in *a
+int ballocRun( daddr32_t goal, int n, daddr32_t *a ) {
+  if (fs.fs_alloc == FS_LIST) {
+    *a = ballocNear( goal );
+    return *a == -1 ? -1 : 1;
+  }
+
+  int len = 0;
+
+  if (fs.fs_dblkno <= goal && goal < fs.fs_size && !BMAP_USED( goal )) {
+    *a = goal;
+    for (len = 1; len < n && goal + len < fs.fs_size && !BMAP_USED( goal + len ); len++)
+      io_stats.al_probes++;
+  }
+  else {
+    const daddr32_t from = fs.fs_alloc == FS_NEXTFIT ? fs.fs_rotor : fs.fs_dblkno;
+
+    if (!bmapScan( from, fs.fs_size, n, a, &len ))
+      bmapScan( fs.fs_dblkno, from, n, a, &len );
+    if (len == 0)
+      return -1; // no more available blocks
+  }
+
+  if (len > n)
+    len = n;
+
+  for (daddr32_t b = *a; b < *a + len; b++)
+    fs_bmap[ b / 8 ] |= 1 << (b % 8);
+
+  fs.fs_rotor = *a + len < fs.fs_size ? *a + len : fs.fs_dblkno;
+  io_stats.al_blocks += len;
+  sbdirty();
+
+  return len;
+}
+
+// allocate n blocks (as few runs as the allocator can manage, from the goal on) into a[], or none at all
+int ballocBlocks( daddr32_t goal, daddr32_t *a, int n ) {
+  for (int i = 0; i < n; ) {
+    daddr32_t s;
+    const int k = ballocRun( goal, n - i, &s );
+
+    if (k == -1) {
+      while (i > 0)
+        bfree( a[ --i ] );
+      return -1;
+    }
+
+    for (goal = s + k; s < goal; s++)
+      a[ i++ ] = s;
+  }
+
+  return n;
+}
+
+int bfree( daddr32_t a ) { // block free
+  // a block shared by reflinked files only loses a reference
+  if (bshared( a )) {
+    fs_rcnt[ a ]--;
+    rcdirty();
+    return 0; // success
+  }
+
+  if (fs.fs_alloc != FS_LIST) {
+    fs_bmap[ a / 8 ] &= ~(1 << (a % 8));
+    sbdirty();
+    return 0; // success
+  }
+
+	if (fs.fs_fdbhead < 63) {
+		fs.fs_fdb[ ++fs.fs_fdbhead ] = a;
+    sbdirty();
+		return 0; // success
+	}
+
+	buf_t *b = bget( a ); // whole block is overwritten, so no need to read it
+	memset( b->b_data, 0, BLOCK_SIZE );
+	memcpy( b->b_data, fs.fs_fdb, 64 * sizeof( daddr32_t ) );
+	bdirty( b );
+	fs.fs_fdb[ 0 ] = a;
+	fs.fs_fdbhead  = 0;
+  sbdirty();
+
+	return 1; // success
+}
+
+/* Reflinked files (see reflink) share data blocks, so each block has a
+ * reference count: the number of extra files mapping it, 0 for a block
+ * with one owner (or none). They're held in memory, like the bitmap, and
+ * written back to the last blocks of the disk along with the superblock.
+ * Freeing a shared block only drops a reference, and a file writing to
+ * one first gets a copy of its own (see ownBlock).
+ */
+
+// whether block a is mapped by more than one file
+int bshared( daddr32_t a ) {
+  return fs.fs_rcblkno != 0 && a != 0 && fs_rcnt[ a ] > 0;
+}
+
+void rcdirty() {
+  fs_rcdirty = 1;
+  sbdirty();
+}
+
+// === SUPERBLOCK FUNCTIONS ===
+
+void wipe( falloc_t alloc ) {
+  // nothing cached for the old filesystem is worth keeping
+  bcache_init();
+  icache_init();
+  dcache_init();
+
+  // superblock
+  fs.fs_sblkno  = 1;
+  fs.fs_size    = 2048;
+  fs.fs_iblkno  = 2;
+  fs.fs_isize   = 64*8;
+  fs.fs_dblkno  = 66;
+  fs.fs_dsize   = 1982;
+  fs.fs_fdbhead = (fs.fs_dsize%64)-1;
+  fs.fs_clean   = 0;
+  fs.fs_alloc   = alloc;
+  fs.fs_bmblkno = 0;
+
+  // every inode bar the root directory is free: list the first few, lowest at the back
+  for (int i = 0; i < FIL_LIMIT; i++)
+    fs.fs_fil[ i ] = FIL_LIMIT - i;
+  fs.fs_nfil    = FIL_LIMIT;
+
+  // whatever it was, the old working directory is gone
+  cwd = ROOT_DIR;
+
+  if (alloc == FS_LIST) {
+    // free list blocks (consecutive, so written a run at a time)
+    for (int i = 0; i < 30; i += BATCH_LIMIT) {
+      const int m = 30 - i > BATCH_LIMIT ? BATCH_LIMIT : 30 - i;
+
+      for (int k = 0; k < m; k++) {
+        daddr32_t *fdb = (daddr32_t*)batch[ k ];
+
+        if (i+k == 29) 
+          fdb[ 0 ] = fs.fs_sblkno;
+        else
+          fdb[ 0 ] = i+k + 1 + fs.fs_dblkno;
+
+        for (int j = 0; j < 63; j++)
+          fdb[ j+1 ] = 63*(i+k) + j + (fs.fs_dblkno + 30);
+      }
+
+      disk_wrn( i + fs.fs_dblkno, batch[ 0 ], m );
+    }
+
+    fs.fs_fdb[ 0 ] = fs.fs_dblkno;
+    for (int i = 1; i < 62; i++) {
+      fs.fs_fdb[ i ] = i + 1986; // 66 + 30 * 64
+    }
+  }
+  else {
+    // the bitmap takes the first data block, and marks every block before the rest as in use
+    fs.fs_bmblkno = fs.fs_dblkno++;
+    fs.fs_dsize--;
+    fs.fs_rotor   = fs.fs_dblkno;
+
+    fs.fs_fdb[ 0 ] = fs.fs_sblkno; // (empty free list)
+    fs.fs_fdbhead  = 0;
+
+    memset( fs_bmap, 0, BMAP_LIMIT );
+    for (daddr32_t a = 0; a < fs.fs_dblkno; a++)
+      fs_bmap[ a / 8 ] |= 1 << (a % 8);
+  }
+
+  // block reference counts take the last blocks of the disk, i.e., the top of the free list (or of the bitmap)
+  const int nrc = (fs.fs_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+  fs.fs_rcblkno = fs.fs_size - nrc;
+  fs.fs_dsize  -= nrc;
+
+  if (alloc == FS_LIST)
+    fs.fs_fdbhead -= nrc;
+  else {
+    for (daddr32_t a = fs.fs_rcblkno; a < fs.fs_size; a++)
+      fs_bmap[ a / 8 ] |= 1 << (a % 8);
+  }
+
+  memset( fs_rcnt, 0, RCNT_LIMIT );
+  fs_rcdirty = 1;
+
+  sbdirty();
+
+  // root directory
+  icommon_t root;
+  memset( &root, 0, sizeof( icommon_t ) );
+
+  root.ic_mode = IFDIR;
+  root.ic_size = 32;
+  root.ic_db[ 0 ] = balloc();
+
+  dir_t dir[ 16 ];
+  memset( dir, 0, sizeof( dir ) );
+  dir[ 0 ].d_ino = ROOT_DIR;
+  dir[ 0 ].d_namlen = 1;
+  dir[ 0 ].d_name[ 0 ] = '.';
+
+  bcache_wr( root.ic_db[ 0 ], (uint8_t *)dir, 16 * sizeof( dir_t ) );
+
+  // inode blocks (consecutive, all unused bar the root directory)
+  memset( batch, 0, sizeof( batch ) );
+  ((icommon_t*)batch[ 0 ])[ ROOT_DIR ] = root;
+
+  for (int i = 0; i < 64; i += BATCH_LIMIT) {
+    disk_wrn( i + fs.fs_iblkno, batch[ 0 ], BATCH_LIMIT );
+    memset( batch[ 0 ], 0, BLOCK_SIZE );
+  }
+
+  createObjFiles();
+
+  isync();
+  sbflush();
+  bsync();
+
+  return;
+}
+
+/* The superblock changes on every block allocated or freed, so rather
+ * than written through each time, it's only marked dirty, then written
+ * back by sbflush: on sync, on unmount, and at the first syscall after
+ * every SYNC_PERIOD timer ticks (the timer interrupt only notes it's due,
+ * since writing back polls the disk). The free list on disk may therefore lag behind the inodes, so
+ * fs_clean records whether it can be trusted: unmount sets it, and the
+ * first change after that clears it (on disk, before anything else is
+ * written back). A filesystem found not clean at boot has its free list
+ * rebuilt from the blocks the inodes actually use.
+ */
+
+void sbdirty() {
+  fs_dirty = 1;
+
+  if (fs.fs_clean) {
+    fs.fs_clean = 0;
+    sbflush();
+    bsync();
+  }
+}
+
+void sbflush() {
+  if (fs_dirty) {
+    bcache_wr( fs.fs_sblkno, (uint8_t*)(&fs), sizeof( fs_t ) );
+    if (fs.fs_alloc != FS_LIST)
+      bcache_wr( fs.fs_bmblkno, fs_bmap, BMAP_LIMIT );
+    fs_dirty = 0;
+  }
+
+  if (fs_rcdirty && fs.fs_rcblkno != 0) {
+    for (daddr32_t a = fs.fs_rcblkno; a < fs.fs_size; a++)
+      bcache_wr( a, fs_rcnt + (a - fs.fs_rcblkno) * BLOCK_SIZE, BLOCK_SIZE );
+    fs_rcdirty = 0;
+  }
+}
+
+int unmount() {
+  isync();
+
+  fs.fs_clean = 1;
+  fs_dirty    = 1;
+
+  sbflush();
+  return bsync();
+}
+
+// mark every block a file uses (data and index blocks), by address, in a bitmap; counting in refs (if given) those marked already
+void markDataBlocks( uint8_t *used, uint8_t *refs, const inode_t *inode ) {
+  if (inode->i_ic.ic_flags & IC_INLINE)
+    return; // no blocks
+
+  if (inode->i_ic.ic_flags & IC_DIRHASH) {
+    dirdot_t dot;
+    readDot( inode, &dot );
+
+    for (int i = 0; i < dot.dx_nblk && i < DX_LIMIT; i++) {
+      if (fs.fs_dblkno <= dot.dx_blk[ i ] && dot.dx_blk[ i ] < fs.fs_size)
+        used[ dot.dx_blk[ i ] / 8 ] |= 1 << (dot.dx_blk[ i ] % 8);
+    }
+  }
+
+  if (inode->i_ic.ic_flags & IC_EXTENTS) {
+    for (int i = 0; i < inode->i_ic.ic_next; i++) {
+      const extent_t e = readExtent( inode, i );
+
+      for (daddr32_t a = e.e_start; a < e.e_start + e.e_len && e.e_start != 0; a++) { // (bar a hole)
+        if (fs.fs_dblkno <= a && a < fs.fs_size) {
+          if (refs != NULL && (used[ a / 8 ] & (1 << (a % 8))) && refs[ a ] < RCNT_MAX)
+            refs[ a ]++; // marked already, by a file it's reflinked to
+          used[ a / 8 ] |= 1 << (a % 8);
+        }
+      }
+    }
+
+    const daddr32_t xb = inode->i_ic.ic_xb;
+    if (inode->i_ic.ic_next > NEXTENT && fs.fs_dblkno <= xb && xb < fs.fs_size)
+      used[ xb / 8 ] |= 1 << (xb % 8);
+
+    return;
+  }
+
+  const int ls   = BLOCK_SIZE/4;
+  const int nblk = inode->i_ic.ic_size / BLOCK_SIZE + 1; // as allocated (see allocateDataBlocks)
+
+  daddr32_t a[ 4 ]; // a data block, plus (at most) three index blocks leading to it
+
+  for (int blk = 0; blk < nblk; blk++) {
+    int n = 0, r = blk - NDADDR;
+
+    a[ n++ ] = getDataBlockAddr( inode, blk * BLOCK_SIZE );
+
+    if (r == 0) {
+      a[ n++ ] = inode->i_ic.ic_ib[ 0 ];
+    }
+    else if ((r -= ls) >= 0 && r < ls*ls) {
+      if (r == 0)
+        a[ n++ ] = inode->i_ic.ic_ib[ 1 ];
+      if (r % ls == 0)
+        a[ n++ ] = ((uint32_t*)bread( inode->i_ic.ic_ib[ 1 ] )->b_data)[ r/ls ];
+    }
+    else if ((r -= ls*ls) >= 0) {
+      uint32_t *t = (uint32_t*)bread( inode->i_ic.ic_ib[ 2 ] )->b_data;
+
+      if (r == 0)
+        a[ n++ ] = inode->i_ic.ic_ib[ 2 ];
+      if (r % (ls*ls) == 0)
+        a[ n++ ] = t[ r/(ls*ls) ];
+      if (r % ls == 0)
+        a[ n++ ] = ((uint32_t*)bread( t[ r/(ls*ls) ] )->b_data)[ (r%(ls*ls))/ls ];
+    }
+
+    for (int i = 0; i < n; i++) {
+      if (fs.fs_dblkno <= a[ i ] && a[ i ] < fs.fs_size)
+        used[ a[ i ] / 8 ] |= 1 << (a[ i ] % 8);
+    }
+  }
+}
+
+// rebuild the free list from the blocks every inode uses
+void recover() {
+  uint8_t used[ ( 2048 + 7 ) / 8 ];
+  memset( used, 0, sizeof( used ) );
+  memset( fs_rcnt, 0, RCNT_LIMIT ); // counted afresh, from the files sharing each block
+
+  if (fs.fs_size > 8 * sizeof( used ) || fs.fs_dblkno >= fs.fs_size || fs.fs_alloc > FS_BESTFIT)
+    return; // not a filesystem we know the layout of (e.g., never wiped)
+
+  for (int ino = 0; ino < fs.fs_isize; ino++) {
+    inode_t inode;
+    readInode( &inode, ino );
+
+    if (inode.i_ic.ic_mode != IFZERO)
+      markDataBlocks( used, fs_rcnt, &inode );
+  }
+
+  // so are the reference counts, which take the last blocks
+  if (fs.fs_rcblkno != 0) {
+    for (daddr32_t a = fs.fs_rcblkno; a < fs.fs_size; a++)
+      used[ a / 8 ] |= 1 << (a % 8);
+    fs_rcdirty = 1;
+  }
+
+  refillFreeInodes();
+
+  // a bitmap is simply replaced
+  if (fs.fs_alloc != FS_LIST) {
+    memset( fs_bmap, 0, BMAP_LIMIT );
+    memcpy( fs_bmap, used, sizeof( used ) );
+    for (daddr32_t a = 0; a < fs.fs_dblkno; a++)
+      fs_bmap[ a / 8 ] |= 1 << (a % 8);
+
+    fs_dirty = 1;
+    sbflush();
+    bsync();
+    return;
+  }
+
+  // push the free blocks from the top down, so they come back out lowest first
+  fs.fs_fdb[ 0 ] = fs.fs_sblkno;
+  fs.fs_fdbhead  = 0;
+
+  for (int a = fs.fs_size - 1; a >= (int)fs.fs_dblkno; a--) {
+    if (!(used[ a / 8 ] & (1 << (a % 8))))
+      bfree( a );
+  }
+
+  sbflush();
+  bsync();
+}
+
+// === DATA BLOCK FUNCTIONS ===
+
+/* An inode flagged IC_EXTENTS maps its data blocks as runs (extents)
+ * rather than one address per block: the first NEXTENT are held in the
+ * inode itself, so mapping any offset of a file with few extents takes
+ * no disk reads at all, and any more in a single extent block (ic_xb).
+ * ballocRun lets a file grow its last extent, a run at a time, wherever
+ * it can.
+ */
+
+// extent i of an extent mapped inode
+extent_t readExtent( const inode_t *inode, int i ) {
+  if (i < NEXTENT)
+    return inode->i_ic.ic_ext[ i ];
+
+  return ((extent_t*)bread( inode->i_ic.ic_xb )->b_data)[ i - NEXTENT ];
+}
+
+// update extent i of an extent mapped inode (the caller writes back the inode itself)
+void writeExtent( inode_t *inode, int i, extent_t e ) {
+  if (i < NEXTENT) {
+    inode->i_ic.ic_ext[ i ] = e;
+    return;
+  }
+
+  buf_t *b = bread( inode->i_ic.ic_xb );
+  ((extent_t*)b->b_data)[ i - NEXTENT ] = e;
+  bdirty( b );
+}
+
+#define INDEX( b ) ( (uint32_t*)(b)->b_data )
+
+// address of the index block mapping block blk of a block mapped inode (past its direct blocks), and the first block it maps
+daddr32_t getLeafIndex( const inode_t *inode, int blk, int *first ) {
+  const int ls = BLOCK_SIZE/4;
+  daddr32_t a;
+
+  if      ((blk -= NDADDR) < ls) {
+    *first = NDADDR;
+    return inode->i_ic.ic_ib[ 0 ];
+  }
+  else if ((blk -= ls) < ls*ls) {
+    *first = NDADDR + ls + blk - blk % ls;
+    return INDEX( bread( inode->i_ic.ic_ib[ 1 ] ) )[ blk/ls ];
+  }
+  else {
+    blk -= ls*ls;
+    *first = NDADDR + ls + ls*ls + blk - blk % ls;
+    a = INDEX( bread( inode->i_ic.ic_ib[ 2 ] ) )[ blk/(ls*ls) ];
+    return INDEX( bread( a ) )[ (blk%(ls*ls))/ls ];
+  }
+}
+
+int getDataBlockAddr( const inode_t *inode, uint32_t byte ) { 
+  int blk = byte / BLOCK_SIZE, first;
+
+  // Extents (reading the extent block, if any, just the once)
+  if (inode->i_ic.ic_flags & IC_EXTENTS) {
+    const extent_t *xb = NULL;
+
+    for (int i = 0; i < inode->i_ic.ic_next; i++) {
+      if (i == NEXTENT)
+        xb = (extent_t*)bread( inode->i_ic.ic_xb )->b_data;
+
+      const extent_t e = i < NEXTENT ? inode->i_ic.ic_ext[ i ] : xb[ i - NEXTENT ];
+
+      if (blk < e.e_len)
+        return e.e_start == 0 ? 0 : e.e_start + blk; // (a hole)
+      blk -= e.e_len;
+    }
+
+    return -1;
+  }
+
+  // Direct block
+  if (blk < NDADDR)
+    return (int)inode->i_ic.ic_db[ blk ];
+
+  // Indirect blocks
+  const daddr32_t leaf = getLeafIndex( inode, blk, &first );
+  return INDEX( bread( leaf ) )[ blk - first ];
+}
+
+/* An open file remembers where the block map took it last (a cursor):
+ * the extent holding the block it last mapped, or the index block that
+ * maps it. A block the cursor covers is mapped without walking the map
+ * again, and once sequential I/O leaves an extent the walk carries on
+ * from the next one, so each index block is read once per pass rather
+ * than once per block. Appending never moves a block already mapped,
+ * so cursors are only invalidated by whatever does move one: truncation,
+ * ownBlock giving a block its own copy, and reflink. Each bumps i_gen,
+ * so every file open on the inode walks the map again.
+ */
+
+int getFileBlockAddr( ofile_t *ofile, uint32_t byte ) {
+  const inode_t *inode = ofile->o_inptr;
+  const uint32_t blk   = byte / BLOCK_SIZE;
+
+  if (ofile->o_mgen != inode->i_gen)
+    ofile->o_mlen = 0; // stale
+
+  if (ofile->o_mfirst <= blk && blk < ofile->o_mfirst + ofile->o_mlen) {
+    if (inode->i_ic.ic_flags & IC_EXTENTS)
+      return ofile->o_maddr == 0 ? 0 : ofile->o_maddr + (blk - ofile->o_mfirst);
+
+    return INDEX( bread( ofile->o_maddr ) )[ blk - ofile->o_mfirst ];
+  }
+
+  if (inode->i_ic.ic_flags & IC_EXTENTS) {
+    // on from the cursor's extent (which may have grown since) if the block is past it, else from the start
+    int      i   = 0;
+    uint32_t off = 0;
+
+    if (ofile->o_mlen > 0 && blk >= ofile->o_mfirst) {
+      i   = ofile->o_mext;
+      off = ofile->o_mfirst;
+    }
+
+    for (; i < inode->i_ic.ic_next; i++) {
+      const extent_t e = readExtent( inode, i );
+
+      if (blk < off + e.e_len) {
+        ofile->o_mgen   = inode->i_gen;
+        ofile->o_mext   = i;
+        ofile->o_mfirst = off;
+        ofile->o_mlen   = e.e_len;
+        ofile->o_maddr  = e.e_start;
+
+        return e.e_start == 0 ? 0 : e.e_start + (blk - off);
+      }
+      off += e.e_len;
+    }
+
+    return -1;
+  }
+
+  if (blk < NDADDR)
+    return (int)inode->i_ic.ic_db[ blk ];
+
+  int first;
+  const daddr32_t leaf = getLeafIndex( inode, blk, &first );
+  const int       addr = INDEX( bread( leaf ) )[ blk - first ];
+
+  ofile->o_mgen   = inode->i_gen;
+  ofile->o_mfirst = first;
+  ofile->o_mlen   = BLOCK_SIZE/4;
+  ofile->o_maddr  = leaf;
+
+  return addr;
+}
+
+// append extent e (a hole if e.e_start is 0) to an extent mapped inode, merging it into the last one if it carries on from it
+int appendExtent( inode_t *inode, extent_t e ) {
+  icommon_t *ic = &inode->i_ic;
+
+  if (ic->ic_next > 0) {
+    extent_t l = readExtent( inode, ic->ic_next - 1 );
+
+    if (l.e_start == 0 ? e.e_start == 0 : e.e_start == l.e_start + l.e_len) {
+      l.e_len += e.e_len;
+      writeExtent( inode, ic->ic_next - 1, l );
+      return 0;
+    }
+  }
+
+  if (ic->ic_next == NEXTENT + NXEXTENT)
+    return -1; // too fragmented
+
+  if (ic->ic_next == NEXTENT) {
+    int xb = balloc();
+    if (xb == -1)
+      return -1;
+
+    buf_t *b = bget( xb ); // new, so nothing to read
+    memset( b->b_data, 0, BLOCK_SIZE );
+    bdirty( b );
+    ic->ic_xb = xb;
+  }
+
+  writeExtent( inode, ic->ic_next++, e );
+  return 0;
+}
+
+// where an extent mapped inode's next block would best go: just past its last data block (bar a hole after it)
+daddr32_t extentGoal( const inode_t *inode ) {
+  for (int i = inode->i_ic.ic_next - 1; i >= 0 && i >= inode->i_ic.ic_next - 2; i--) {
+    const extent_t e = readExtent( inode, i );
+    if (e.e_start != 0)
+      return e.e_start + e.e_len;
+  }
+
+  return 0;
+}
+
+// append n blocks to an extent mapped inode, extending its last extent where possible; returns the first's address
+int allocateExtentBlocks( inode_t *inode, int n ) {
+  int first = -1;
+
+  while (n > 0) {
+    daddr32_t addr;
+    const int k = ballocRun( extentGoal( inode ), n, &addr );
+    if (k == -1)
+      return -1;
+
+    const extent_t e = { addr, k };
+    if (appendExtent( inode, e ) == -1) {
+      for (int i = 0; i < k; i++)
+        bfree( addr + i );
+      return -1;
+    }
+
+    if (first == -1)
+      first = addr;
+    n -= k;
+
+    writeInode( inode );
+  }
+
+  return first;
+}
+
+/* Sparse files: an extent whose e_start is 0 is a hole, i.e., a run of
+ * blocks that have no data block at all. A hole reads as zeroes without
+ * any I/O (breadn hands out bc_hole for address 0), and is only given a
+ * data block once a write lands in it. Growing a file past its end, by
+ * ftruncate or by a write beyond it, turns the whole blocks skipped over
+ * into a hole rather than allocating (and zeroing) them. Files still
+ * mapped by direct / indirect blocks keep allocating every block. A
+ * block written to in a hole gets a data block of its own by ownBlock,
+ * as does a block shared with a reflinked file.
+ */
+
+extent_t emap[ NEXTENT + NXEXTENT + 2 ]; // extents of the inode ownBlock works on
+
+// whether extent f carries straight on from extent e (a hole from a hole, or data from the block after e's)
+int extentJoins( extent_t e, extent_t f ) {
+  return e.e_start == 0 ? f.e_start == 0 : f.e_start == e.e_start + e.e_len;
+}
+
+// give block blk of an extent mapped inode a data block of its own, if it lies in a hole or is shared (see reflink):
+// filled iff. fill (zeroed, or copied from the shared one), else left for the caller to overwrite; returns its address
+int ownBlock( inode_t *inode, int blk, const int fill ) {
+  icommon_t *ic = &inode->i_ic;
+  int i, off = 0, n = ic->ic_next;
+
+  if (!(ic->ic_flags & IC_EXTENTS))
+    return -1; // never has holes, nor shares blocks
+
+  for (int j = 0; j < n; j++)
+    emap[ j ] = readExtent( inode, j );
+
+  for (i = 0; i < n && blk >= off + (int)emap[ i ].e_len; i++)
+    off += emap[ i ].e_len;
+
+  if (i == n)
+    return -1; // past the end
+
+  const extent_t e    = emap[ i ];
+  const int      k    = blk - off;                  // blocks of the extent before it
+  const int      rest = e.e_len - k - 1;            // ... and after it
+  const daddr32_t old = e.e_start == 0 ? 0 : e.e_start + k;
+
+  if (old != 0 && !bshared( old ))
+    return old; // its own already
+
+  daddr32_t addr;
+  if (ballocRun( old != 0 ? old : i > 0 && emap[ i-1 ].e_start != 0 ? emap[ i-1 ].e_start + emap[ i-1 ].e_len : extentGoal( inode ), 1, &addr ) == -1)
+    return -1;
+
+  // the extent is split around the block, then rejoined to its neighbours wherever they carry straight on
+  extent_t x[ 3 ];
+  int      m = 0;
+
+  if (k > 0) {
+    x[ m ].e_start = e.e_start; x[ m++ ].e_len = k;
+  }
+  x[ m ].e_start = addr; x[ m++ ].e_len = 1;
+  if (rest > 0) {
+    x[ m ].e_start = old == 0 ? 0 : old + 1; x[ m++ ].e_len = rest;
+  }
+
+  memmove( &emap[ i + m ], &emap[ i + 1 ], (n - i - 1) * sizeof( extent_t ) );
+  memcpy( &emap[ i ], x, m * sizeof( extent_t ) );
+
+  const int first = i > 0 ? i - 1 : 0; // first extent that may change
+  int count = n - 1 + m, last = i + m < count ? i + m : count - 1;
+
+  for (int j = first; j < last; ) {
+    if (extentJoins( emap[ j ], emap[ j+1 ] )) {
+      emap[ j ].e_len += emap[ j+1 ].e_len;
+      memmove( &emap[ j+1 ], &emap[ j+2 ], (count - j - 2) * sizeof( extent_t ) );
+      count--; last--;
+    }
+    else j++;
+  }
+
+  if (count > NEXTENT + NXEXTENT) {
+    bfree( addr ); // too fragmented
+    return -1;
+  }
+
+  if (count > NEXTENT && n <= NEXTENT) {
+    int xb = balloc();
+    if (xb == -1) {
+      bfree( addr );
+      return -1;
+    }
+
+    buf_t *b = bget( xb ); // new, so nothing to read
+    memset( b->b_data, 0, BLOCK_SIZE );
+    bdirty( b );
+    ic->ic_xb = xb;
+  }
+  else if (count <= NEXTENT && n > NEXTENT) {
+    bfree( ic->ic_xb );
+    ic->ic_xb = 0;
+  }
+
+  ic->ic_next = count;
+  for (int j = first; j < count; j++)
+    writeExtent( inode, j, emap[ j ] );
+
+  if (fill) {
+    const buf_t *o = old != 0 ? bread( old ) : NULL;
+    buf_t       *b = bget( addr ); // new, so nothing to read
+
+    if (o != NULL) memcpy( b->b_data, o->b_data, BLOCK_SIZE );
+    else           memset( b->b_data, 0, BLOCK_SIZE );
+    bdirty( b );
+  }
+
+  if (old != 0)
+    bfree( old ); // one reference fewer
+
+  inode->i_gen++;
+  writeInode( inode );
+
+  return addr;
+}
+
+/* A block mapped inode grows a chunk (up to an index block's worth of
+ * blocks) at a time: every data block, and every index block needed to
+ * map them, is reserved by a single allocator call, then the addresses
+ * are filled in where the buffer cache holds each index block, so each
+ * is read (if at all) and written back once, as is the inode.
+ */
+
+// number of index blocks that must be created to map block blk (those before it being mapped already)
+int newIndexBlocks( int blk ) {
+  const int ls = BLOCK_SIZE/4;
+
+  if ((blk -= NDADDR) < 0)
+    return 0;
+  if (blk < ls)
+    return blk == 0;
+  if ((blk -= ls) < ls*ls)
+    return (blk == 0) + (blk % ls == 0);
+
+  blk -= ls*ls;
+  return (blk == 0) + (blk % (ls*ls) == 0) + (blk % ls == 0);
+}
+
+// the index block whose address is in *slot (of buffer p, or the inode if NULL), created from a reserved block if fresh
+buf_t *indexBlock( buf_t *p, uint32_t *slot, int fresh, const daddr32_t *reserved, int *j ) {
+  buf_t *b;
+
+  if (fresh) {
+    *slot = reserved[ (*j)++ ];
+    if (p != NULL)
+      bdirty( p );
+
+    b = bget( *slot ); // new, so nothing to read
+    memset( b->b_data, 0, BLOCK_SIZE );
+  }
+  else {
+    b = bread( *slot );
+  }
+
+  bdirty( b ); // (its caller fills it in)
+  return b;
+}
+
+// where the address of block blk of a block mapped inode goes, creating the index blocks leading to it as need be
+uint32_t *indexSlot( inode_t *inode, int blk, const daddr32_t *reserved, int *j ) {
+  const int ls = BLOCK_SIZE/4;
+  icommon_t *ic = &inode->i_ic;
+  buf_t     *b1, *b2, *b3;
+
+  if (blk < NDADDR)
+    return &ic->ic_db[ blk ];
+
+  if ((blk -= NDADDR) < ls) {
+    b1 = indexBlock( NULL, &ic->ic_ib[ 0 ], blk == 0, reserved, j );
+    return &INDEX( b1 )[ blk ];
+  }
+
+  if ((blk -= ls) < ls*ls) {
+    b1 = indexBlock( NULL, &ic->ic_ib[ 1 ],           blk == 0,      reserved, j );
+    b2 = indexBlock( b1,   &INDEX( b1 )[ blk/ls ],    blk % ls == 0, reserved, j );
+    return &INDEX( b2 )[ blk%ls ];
+  }
+
+  blk -= ls*ls;
+  b1 = indexBlock( NULL, &ic->ic_ib[ 2 ],                   blk == 0,           reserved, j );
+  b2 = indexBlock( b1,   &INDEX( b1 )[ blk/(ls*ls) ],       blk % (ls*ls) == 0, reserved, j );
+  b3 = indexBlock( b2,   &INDEX( b2 )[ (blk%(ls*ls))/ls ],  blk % ls == 0,      reserved, j );
+  return &INDEX( b3 )[ blk%ls ];
+}
+
+daddr32_t reserved[ BLOCK_SIZE/4 + NIADDR ]; // blocks reserved by allocateMappedBlocks
+
+// map n new blocks onto a block mapped inode, from block first on; returns the address of the first
+int allocateMappedBlocks( inode_t *inode, int first, int n ) {
+  const int ls = BLOCK_SIZE/4;
+  int addr = -1;
+
+  for (int blk = first; blk < first + n; ) {
+    const int m = first + n - blk > ls ? ls : first + n - blk;
+
+    int k = m;
+    for (int i = blk; i < blk + m; i++)
+      k += newIndexBlocks( i );
+
+    // carry on from the file's last block, if it has one
+    const daddr32_t goal = blk > 0 ? getDataBlockAddr( inode, (blk-1) * BLOCK_SIZE ) + 1 : 0;
+    if (ballocBlocks( goal, reserved, k ) == -1)
+      return -1;
+
+    for (int i = 0, j = 0; i < m; i++, blk++) {
+      uint32_t *slot = indexSlot( inode, blk, reserved, &j );
+      *slot = reserved[ j++ ];
+
+      if (addr == -1)
+        addr = *slot;
+    }
+  }
+
+  writeInode( inode );
+
+  return addr;
+}
+
+int allocateDataBlockAddr( inode_t *inode, uint32_t byte ) { 
+  if (inode->i_ic.ic_flags & IC_EXTENTS)
+    return allocateExtentBlocks( inode, 1 ); // blocks are only ever appended
+
+  return allocateMappedBlocks( inode, byte / BLOCK_SIZE, 1 );
+}
+
+/* A file is created with its data inline (IC_INLINE), i.e., held in the
+ * icommon where the block map would otherwise go, so a file of at most
+ * IDATA_LIMIT bytes (such as the program "object" files) has no data
+ * block at all: reading or writing it is served by the inode alone.
+ * Once it outgrows that, its data moves to a first (extent mapped) data
+ * block, and it carries on like any other file.
+ */
+
+// move an inline file's data into a data block of its own
+int spillInline( inode_t *inode ) {
+  icommon_t *ic = &inode->i_ic;
+  uint8_t data[ IDATA_LIMIT ];
+
+  memcpy( data, ic->ic_data, IDATA_LIMIT );
+  memset( ic->ic_data, 0, IDATA_LIMIT );
+  ic->ic_flags = (ic->ic_flags & ~IC_INLINE) | IC_EXTENTS;
+
+  const int addr = allocateExtentBlocks( inode, 1 );
+  if (addr == -1) {
+    memcpy( ic->ic_data, data, IDATA_LIMIT );
+    ic->ic_flags = (ic->ic_flags & ~IC_EXTENTS) | IC_INLINE;
+    return -1;
+  }
+
+  buf_t *b = bget( addr );
+  memset( b->b_data, 0, BLOCK_SIZE );
+  memcpy( b->b_data, data, ic->ic_size );
+  bdirty( b );
+
+  return addr;
+}
+
+int allocateDataBlocks( inode_t *inode, uint32_t bytes ) {
+  if (inode->i_ic.ic_flags & IC_INLINE) {
+    if (inode->i_ic.ic_size + bytes <= IDATA_LIMIT)
+      return inode->i_ic.ic_size += bytes; // still fits
+
+    if (spillInline( inode ) == -1)
+      return -1;
+  }
+
+  const int b = inode->i_ic.ic_size / BLOCK_SIZE;
+  const int n = (inode->i_ic.ic_size + bytes) / BLOCK_SIZE;
+
+  // extents are allocated as runs, as long as the allocator can find them
+  if (inode->i_ic.ic_flags & IC_EXTENTS) {
+    if (n > b && allocateExtentBlocks( inode, n - b ) == -1)
+      return -1;
+
+    return inode->i_ic.ic_size += bytes;
+  }
+
+  if (n > b && allocateMappedBlocks( inode, b+1, n - b ) == -1)
+    return -1;
+
+  return inode->i_ic.ic_size += bytes;
+}
+
+// grow inode to end bytes, for a write of bytes head up to end: any whole blocks between the old end and head become a
+// hole (extent mapped files), and every other byte before head reads as zero. head == end grows it without a write
+int extendFile( inode_t *inode, uint32_t head, uint32_t end ) {
+  icommon_t *ic = &inode->i_ic;
+  const uint32_t old = ic->ic_size;
+
+  if (end <= old)
+    return 0;
+
+  // inline data past the end is zero already
+  if (ic->ic_flags & IC_INLINE) {
+    if (end <= IDATA_LIMIT)
+      return allocateDataBlocks( inode, end - old );
+    if (spillInline( inode ) == -1)
+      return -1;
+  }
+
+  const uint32_t gap = head > old ? head : old; // bytes from old up to gap aren't written
+
+  // the rest of the last block, up to gap (unless it's a hole), in a block of its own if shared
+  int la = getDataBlockAddr( inode, old );
+  if (gap > old && la > 0 && bshared( la ) && (la = ownBlock( inode, old / BLOCK_SIZE, 1 )) == -1)
+    return -1;
+  if (gap > old && la > 0) {
+    buf_t *b = bread( la );
+    memset( b->b_data + old % BLOCK_SIZE, 0, gap - old < BLOCK_SIZE - old % BLOCK_SIZE ? gap - old : BLOCK_SIZE - old % BLOCK_SIZE );
+    bdirty( b );
+  }
+
+  // whole blocks before the first one written (or all of them, if none is) make a hole
+  const int first = old / BLOCK_SIZE + 1;
+  const int last  = head < end ? gap / BLOCK_SIZE : end / BLOCK_SIZE + 1;
+
+  if ((ic->ic_flags & IC_EXTENTS) && last > first) {
+    const extent_t e = { 0, last - first };
+    if (appendExtent( inode, e ) == -1)
+      return -1;
+
+    ic->ic_size = head < end ? last * BLOCK_SIZE - 1 : end;
+    writeInode( inode );
+  }
+
+  // the rest are allocated
+  const uint32_t from = ic->ic_size;
+  if (end > from && allocateDataBlocks( inode, end - from ) == -1) {
+    truncateInode( inode, old );
+    return -1;
+  }
+
+  // new blocks (so not read) are zeroed up to gap
+  for (uint32_t blk = from / BLOCK_SIZE + 1; blk * BLOCK_SIZE < gap; blk++) {
+    buf_t *b = bget( getDataBlockAddr( inode, blk * BLOCK_SIZE ) );
+    memset( b->b_data, 0, gap - blk * BLOCK_SIZE < BLOCK_SIZE ? gap - blk * BLOCK_SIZE : BLOCK_SIZE );
+    bdirty( b );
+  }
+
+  return 0;
+}
+
+/* Truncation walks the block map once: extents are cut short where the
+ * file now ends, and index blocks are read one at a time, each freeing
+ * the blocks it maps past the end (depth first) before it is itself
+ * freed, if nothing is left in it. So freeing n blocks reads only the
+ * index blocks mapping them, rather than up to three per data block.
+ */
+
+// free the blocks mapped by index block ib (each entry mapping span blocks, from block first on) from block keep up to block end
+void truncateIndex( daddr32_t ib, int span, int first, int keep, int end ) {
+  const int ls = BLOCK_SIZE/4;
+  buf_t    *b  = bread( ib );
+  uint32_t *e  = INDEX( b );
+
+  for (int i = 0; i < ls && first + i*span < end; i++) {
+    const int lo = first + i*span;
+    if (lo + span <= keep)
+      continue; // still in use
+
+    if (span > 1)
+      truncateIndex( e[ i ], span / ls, lo, keep, end );
+
+    if (lo >= keep) {
+      bfree( e[ i ] );
+      e[ i ] = 0;
+    }
+  }
+
+  bdirty( b );
+}
+
+// free every block of inode from block keep on (the caller writes back the inode)
+void truncateBlocks( inode_t *inode, int keep ) {
+  const int ls  = BLOCK_SIZE/4;
+  const int end = inode->i_ic.ic_size / BLOCK_SIZE + 1; // as allocated (see allocateDataBlocks)
+  icommon_t *ic = &inode->i_ic;
+
+  if (ic->ic_flags & IC_INLINE)
+    return; // no blocks
+
+  inode->i_gen++;
+
+  if (ic->ic_flags & IC_EXTENTS) {
+    int n = 0; // extents left
+
+    for (int i = 0, off = 0; i < ic->ic_next; i++) {
+      extent_t  e = readExtent( inode, i );
+      const int k = keep - off >= (int)e.e_len ? (int)e.e_len : keep - off > 0 ? keep - off : 0;
+
+      off += e.e_len;
+      for (uint32_t j = k; j < e.e_len && e.e_start != 0; j++)
+        bfree( e.e_start + j ); // (bar a hole)
+
+      if (k > 0) {
+        n = i + 1;
+        if (k < (int)e.e_len) {
+          e.e_len = k;
+          writeExtent( inode, i, e );
+        }
+      }
+    }
+
+    if (ic->ic_next > NEXTENT && n <= NEXTENT) {
+      bfree( ic->ic_xb );
+      ic->ic_xb = 0;
+    }
+    ic->ic_next = n;
+
+    return;
+  }
+
+  for (int i = keep; i < NDADDR && i < end; i++) {
+    bfree( ic->ic_db[ i ] );
+    ic->ic_db[ i ] = 0;
+  }
+
+  for (int l = 0, first = NDADDR, span = 1; l < NIADDR && first < end; l++, first += span * ls, span *= ls) {
+    if (first + span * ls <= keep)
+      continue; // still in use
+
+    truncateIndex( ic->ic_ib[ l ], span, first, keep, end );
+
+    if (first >= keep) {
+      bfree( ic->ic_ib[ l ] );
+      ic->ic_ib[ l ] = 0;
+    }
+  }
+}
+
+// resize inode to size bytes: blocks past the end are freed, and bytes added read as zeroes
+int truncateInode( inode_t *inode, uint32_t size ) {
+  const uint32_t old = inode->i_ic.ic_size;
+
+  if (size < old) {
+    truncateBlocks( inode, size / BLOCK_SIZE + 1 );
+    inode->i_ic.ic_size = size;
+
+    // inline data past the end must read as zeroes if the file grows again
+    if (inode->i_ic.ic_flags & IC_INLINE)
+      memset( inode->i_ic.ic_data + size, 0, old - size );
+  }
+  else if (size > old && extendFile( inode, size, size ) == -1) {
+    return -1; // (the new blocks are a hole, where possible)
+  }
+
+  writeInode( inode );
+
+  return 0;
+}
+
+int getDataBlock( uint8_t *block, const inode_t *inode, uint32_t byte ) { 
+  int addr = getDataBlockAddr( inode, byte );
+  bcache_rd( addr, block, BLOCK_SIZE );
+  return addr;
+}
+
+// === INODE FUNCTIONS ===
+
+inode_t *readInode( inode_t *in, int ino ) {
+	// TODO: validation in case ino is invalid
+
+  const inode_t *c = iget( ino );
+
+  if (c == NULL) { // every cached inode open: read around the cache
+    in->i_number = ino;
+    in->i_ic     = ((icommon_t*)bread( fs.fs_iblkno + ino / 8 )->b_data)[ ino % 8 ];
+    return in;
+  }
+
+  if (c != in) {
+    in->i_number = c->i_number;
+    in->i_ic     = c->i_ic;
+  }
+
+  return in;
+}
+
+inode_t *writeInode( inode_t *inode ) {
+  inode_t *c = inode;
+
+  // a copy updates the cached inode (if it can be cached)
+  if (inode < &icache[ 0 ] || inode >= &icache[ ICACHE_LIMIT ]) {
+    if ((c = iget( inode->i_number )) == NULL) {
+      buf_t *b = bread( fs.fs_iblkno + inode->i_number / 8 );
+
+      ((icommon_t*)b->b_data)[ inode->i_number % 8 ] = inode->i_ic;
+      bdirty( b );
+      return inode;
+    }
+
+    c->i_ic = inode->i_ic;
+  }
+
+  c->i_flags |= I_DIRTY;
+
+  return inode;
+} 
+
+/* Free inodes are taken from a list kept in the superblock (fs_fil),
+ * and unlink puts them back while there's room, so creating a file
+ * only reads the block of the inode it gets. Once the list runs out
+ * the inode blocks are scanned for more, BATCH_LIMIT blocks per disk
+ * request. The list on disk may be stale after a crash, so each inode
+ * is checked as it's taken (and recover rebuilds the list anyway).
+ * Inodes taken since the last sync may only be in use in the inode
+ * cache, so it's flushed before the scan.
+ */
+
+void refillFreeInodes() {
+  daddr32_t a[ BATCH_LIMIT ];
+  uint8_t  *x[ BATCH_LIMIT ];
+
+  isync();
+  fs.fs_nfil = 0;
+
+  for (int i = 0; i < fs.fs_isize/8 && fs.fs_nfil < FIL_LIMIT; i += BATCH_LIMIT) {
+    const int m = fs.fs_isize/8 - i > BATCH_LIMIT ? BATCH_LIMIT : fs.fs_isize/8 - i;
+
+    for (int k = 0; k < m; k++) {
+      a[ k ] = fs.fs_iblkno + i + k;
+      x[ k ] = batch[ k ];
+    }
+
+    readBlocks( a, x, m );
+
+    for (int k = 0; k < m; k++) {
+      const icommon_t *ic = (icommon_t*)batch[ k ];
+
+      for (int j = 0; j < 8 && fs.fs_nfil < FIL_LIMIT; j++) {
+        if (ic[ j ].ic_mode == IFZERO) // inode unused
+          fs.fs_fil[ fs.fs_nfil++ ] = 8*(i+k) + j;
+      }
+    }
+  }
+
+  // lowest numbered at the back, so taken first
+  for (int i = 0, j = fs.fs_nfil - 1; i < j; i++, j--) {
+    const uint32_t t = fs.fs_fil[ i ];
+    fs.fs_fil[ i ] = fs.fs_fil[ j ];
+    fs.fs_fil[ j ] = t;
+  }
+
+  sbdirty();
+}
+
+inode_t * getFreeInode( inode_t *in ) {
+  while (1) {
+    if (fs.fs_nfil == 0)
+      refillFreeInodes();
+    if (fs.fs_nfil == 0)
+      return NULL;
+
+    readInode( in, fs.fs_fil[ --fs.fs_nfil ] );
+    sbdirty();
+
+    if (in->i_ic.ic_mode == IFZERO) { // inode unused (not stale)
+      memset( &in->i_ic, 0, sizeof( icommon_t ) );
+      in->i_ic.ic_mode  = IFREG;
+      in->i_ic.ic_flags = IC_EXTENTS;
+      in->i_ic.ic_size = 0;
+      return in;
+    }
+  }
+}
+
+dir_t *getLastDir( dir_t *d, const inode_t *inode ) {
+  const int r = ((inode->i_ic.ic_size / 32) - 1) % 16; // offset of last dir, assumes directory non-empty
+  
+  dir_t dir[ 16 ];
+  getDataBlock( (uint8_t*)dir, inode, inode->i_ic.ic_size - 32);
+
+  memcpy( d, &dir[ r ], sizeof( dir_t ) );
+  return d;
+}
+
+int removable( inode_t *parent, dir_t *child ) {
+  // check removing current directory
+  if (child->d_ino == cwd)
+    return -1;
+
+  // check for open file
+  const inode_t *open = ilookup( child->d_ino );
+  if (open != NULL && open->i_links > 0)
+    return -1;
+
+  // check for non-empty directory
+  inode_t inode;
+  readInode( &inode, child->d_ino );
+
+  if (inode.i_ic.ic_mode == IFDIR && inode.i_ic.ic_size > 64) {
+    return -1; // more entries than just . and ..
+  }
+
+  return child->d_ino;
+}
+
+/* A directory outgrowing its first block gets a hash index (IC_DIRHASH):
+ * an open addressed table of DX_SLOTS slots per index block, in up to
+ * DX_LIMIT blocks listed by its "." entry (see dirdot_t). Each slot in
+ * use holds an entry number (plus one, so 0 is free) under 16 bits of
+ * the hash of its name, which also pick the slot probing starts from.
+ * So a lookup reads an index block (found via the "." entry), then only
+ * the directory blocks of entries whose hash matches, usually one. The
+ * table grows by a block (rehashed from the slots alone) once three
+ * quarters full; past DX_LIMIT blocks the directory is scanned instead,
+ * as are those that never grew an index.
+ */
+
+#define DX_VALUE( h, e ) ( ((h) & 0xFFFF) << 16 | ((e) + 1) ) // slot for entry e, whose name hashes to h
+
+uint32_t dirHash( const char *name, int len ) { // FNV-1a
+  uint32_t h = 2166136261u;
+
+  for (int i = 0; i < len; i++)
+    h = (h ^ (uint8_t)name[ i ]) * 16777619u;
+
+  return h;
+}
+
+int dirMatch( const dir_t *d, const char *name, int len ) {
+  return d->d_namlen == len && strncmp( name, d->d_name, len ) == 0; // (a reused block may hold anything past the name)
+}
+
+// entry e of a directory, in the buffer cache (so valid until the next block is read)
+dir_t *dirEntry( const inode_t *dir, int e ) {
+  return &((dir_t*)bread( getDataBlockAddr( dir, (e / 16) * BLOCK_SIZE ) )->b_data)[ e % 16 ];
+}
+
+void readDot( const inode_t *dir, dirdot_t *dot ) {
+  memcpy( dot, dirEntry( dir, 0 ), sizeof( dirdot_t ) );
+}
+
+void writeDot( const inode_t *dir, const dirdot_t *dot ) {
+  buf_t *b = bread( getDataBlockAddr( dir, 0 ) );
+
+  memcpy( b->b_data, dot, sizeof( dirdot_t ) );
+  bdirty( b );
+}
+
+// slot i of a directory's hash index (its block marked dirty iff. w)
+uint32_t *dxSlot( const dirdot_t *dot, int i, int w ) {
+  buf_t *b = bread( dot->dx_blk[ i / DX_SLOTS ] );
+
+  if (w)
+    bdirty( b );
+
+  return &INDEX( b )[ i % DX_SLOTS ];
+}
+
+// slot i of a probe sequence, given slot (if not NULL) was the one before it: only crossing into another block reads it
+const uint32_t *dxNext( const dirdot_t *dot, int i, const uint32_t *slot ) {
+  return slot != NULL && i % DX_SLOTS != 0 ? slot + 1 : dxSlot( dot, i, 0 );
+}
+
+// slot holding entry e, whose name hashes to h (-1 if none does)
+int dxFind( const dirdot_t *dot, uint32_t h, int e ) {
+  const int cap = dot->dx_nblk * DX_SLOTS;
+  const uint32_t *slot = NULL;
+
+  for (int i = (h & 0xFFFF) % cap, n = 0; n < cap; i = (i + 1) % cap, n++) {
+    slot = dxNext( dot, i, slot );
+
+    if (*slot == 0)
+      break;
+    if (*slot == DX_VALUE( h, e ))
+      return i;
+  }
+
+  return -1;
+}
+
+void dxInsert( const dirdot_t *dot, uint32_t h, int e ) {
+  const int cap = dot->dx_nblk * DX_SLOTS;
+  const uint32_t *slot = NULL;
+  int i = (h & 0xFFFF) % cap;
+
+  while (*(slot = dxNext( dot, i, slot )) != 0)
+    i = (i + 1) % cap;
+
+  *dxSlot( dot, i, 1 ) = DX_VALUE( h, e );
+}
+
+// free slot i, moving back any slot after it that probing would no longer reach
+void dxDelete( const dirdot_t *dot, int i ) {
+  const int cap = dot->dx_nblk * DX_SLOTS;
+
+  for (int j = (i + 1) % cap; ; j = (j + 1) % cap) {
+    const uint32_t v = *dxSlot( dot, j, 0 );
+    if (v == 0)
+      break;
+
+    const int home = (v >> 16) % cap;
+    if (i < j ? (home <= i || home > j) : (home <= i && home > j)) {
+      *dxSlot( dot, i, 1 ) = v;
+      i = j;
+    }
+  }
+
+  *dxSlot( dot, i, 1 ) = 0;
+}
+
+// (re)build a directory's hash index in nblk blocks, leaving it as it was if they can't be allocated
+int dxBuild( inode_t *dir, dirdot_t *dot, int nblk ) {
+  const dirdot_t old = *dot;
+
+  if (ballocBlocks( getDataBlockAddr( dir, 0 ) + 1, dot->dx_blk, nblk ) == -1) {
+    *dot = old;
+    return -1;
+  }
+
+  for (int i = 0; i < nblk; i++) {
+    buf_t *b = bget( dot->dx_blk[ i ] );
+    memset( b->b_data, 0, BLOCK_SIZE );
+    bdirty( b );
+  }
+
+  dot->dx_nblk = nblk;
+
+  if (dir->i_ic.ic_flags & IC_DIRHASH) {
+    // slots carry (enough of) their hash to be moved as they are
+    for (int i = 0; i < old.dx_nblk * DX_SLOTS; i++) {
+      const uint32_t v = *dxSlot( &old, i, 0 );
+      if (v != 0)
+        dxInsert( dot, v >> 16, (v & 0xFFFF) - 1 );
+    }
+
+    for (int i = 0; i < old.dx_nblk; i++)
+      bfree( old.dx_blk[ i ] );
+  }
+  else {
+    for (int e = 0; e < dir->i_ic.ic_size / 32; e++) {
+      const dir_t *d = dirEntry( dir, e );
+      dxInsert( dot, dirHash( d->d_name, d->d_namlen ), e );
+    }
+
+    dir->i_ic.ic_flags |= IC_DIRHASH;
+  }
+
+  return 0;
+}
+
+// stop indexing a directory (the caller writes back its "." entry and inode)
+void dxDrop( inode_t *dir, dirdot_t *dot ) {
+  for (int i = 0; i < dot->dx_nblk; i++)
+    bfree( dot->dx_blk[ i ] );
+
+  dot->dx_nblk = 0;
+  dir->i_ic.ic_flags &= ~IC_DIRHASH;
+}
+
+// index entry e, just added to a directory (the caller writes back its inode)
+void dirIndexAdd( inode_t *dir, const char *name, int e ) {
+  const int dirs = e + 1;
+  dirdot_t  dot;
+
+  if (!(dir->i_ic.ic_flags & IC_DIRHASH)) {
+    const int nblk = (4 * dirs + 3 * DX_SLOTS - 1) / (3 * DX_SLOTS); // at most three quarters full
+
+    // a single block is scanned as quickly
+    if (dirs > 16 && nblk <= DX_LIMIT) {
+      readDot( dir, &dot );
+      if (dxBuild( dir, &dot, nblk ) != -1)
+        writeDot( dir, &dot );
+    }
+
+    return;
+  }
+
+  readDot( dir, &dot );
+  dxInsert( &dot, dirHash( name, strlen( name ) ), e );
+
+  if (4 * dirs > 3 * dot.dx_nblk * DX_SLOTS) {
+    if (dot.dx_nblk == DX_LIMIT || dxBuild( dir, &dot, dot.dx_nblk + 1 ) == -1)
+      dxDrop( dir, &dot );
+
+    writeDot( dir, &dot );
+  }
+}
+
+// entry number of name in a directory (copied into d), or -1
+int dirFind( const inode_t *dir, const char *name, dir_t *d ) {
+  const int len = strlen( name );
+
+  if (dir->i_ic.ic_flags & IC_INLINE)
+    return -1; // a (small) file, not a directory
+
+  if (dir->i_ic.ic_flags & IC_DIRHASH) {
+    const uint32_t h = dirHash( name, len );
+    dirdot_t dot;
+
+    readDot( dir, &dot );
+    const int cap = dot.dx_nblk * DX_SLOTS;
+
+    const uint32_t *slot = NULL;
+
+    for (int i = (h & 0xFFFF) % cap, n = 0; n < cap; i = (i + 1) % cap, n++) {
+      slot = dxNext( &dot, i, slot );
+
+      if (*slot == 0)
+        break;
+      if ((*slot >> 16) != (h & 0xFFFF))
+        continue;
+
+      const int e = (*slot & 0xFFFF) - 1;
+      const dir_t *c = dirEntry( dir, e );
+      if (dirMatch( c, name, len )) {
+        memcpy( d, c, sizeof( dir_t ) );
+        return e;
+      }
+
+      slot = NULL; // (its block is read again)
+    }
+
+    return -1;
+  }
+
+  const dir_t *blk = NULL;
+
+  for (int e = 0; e < dir->i_ic.ic_size / 32; e++) {
+    if (e % 16 == 0)
+      blk = dirEntry( dir, e );
+
+    if (dirMatch( &blk[ e % 16 ], name, len )) {
+      memcpy( d, &blk[ e % 16 ], sizeof( dir_t ) );
+      return e;
+    }
+  }
+
+  return -1; // does not exist in directory
+}
+
+int remove( dir_t *child, inode_t *parent, const char *name ) {
+  const int e = dirFind( parent, name, child );
+  if (e == -1 || removable( parent, child ) == -1)
+    return -1;
+
+  // the last entry takes its place
+  const int last = parent->i_ic.ic_size / 32 - 1;
+  dir_t d;
+  getLastDir( &d, parent );
+
+  buf_t *b = bread( getDataBlockAddr( parent, (e / 16) * BLOCK_SIZE ) );
+  ((dir_t*)b->b_data)[ e % 16 ] = d;
+  bdirty( b );
+
+  if (parent->i_ic.ic_flags & IC_DIRHASH) {
+    dirdot_t dot;
+    readDot( parent, &dot );
+
+    const int i = dxFind( &dot, dirHash( child->d_name, child->d_namlen ), e );
+    if (i != -1)
+      dxDelete( &dot, i );
+
+    const int j = e != last ? dxFind( &dot, dirHash( d.d_name, d.d_namlen ), last ) : -1;
+    if (j != -1)
+      *dxSlot( &dot, j, 1 ) = DX_VALUE( dirHash( d.d_name, d.d_namlen ), e );
+  }
+
+  // a block emptied of entries is freed, as a directory's last block is only allocated once an entry needs it
+  if ((parent->i_ic.ic_size - 32) % BLOCK_SIZE == 0 && parent->i_ic.ic_size > 32)
+    truncateBlocks( parent, (parent->i_ic.ic_size - 32) / BLOCK_SIZE );
+
+  parent->i_ic.ic_size -= 32;
+  writeInode( parent );
+
+  dforget( parent->i_number, child->d_name, child->d_namlen );
+
+  return child->d_ino;
+}
+
+int name_to_ino( const char *name, const inode_t *in ) {
+  dir_t d;
+
+  return dirFind( in, name, &d ) == -1 ? -1 : (int)d.d_ino;
+}
+
+// inode number of name in directory dir (-1 if none), via the dentry cache
+int dirLookup( const int dir, const char *name ) {
+  const int len = strlen( name );
+  int       ino = dlookup( dir, name, len );
+
+  if (ino == -2) {
+    inode_t inode;
+    readInode( &inode, dir );
+    ino = name_to_ino( name, &inode );
+
+    // only a directory's entries are cached (a file's "entries" change as it's written)
+    if (inode.i_ic.ic_mode == IFDIR)
+      denter( dir, name, len, ino );
+  }
+
+  return ino;
+}
+
+int path_to_ino( char *path, const int dir ) {
+  int 		 ino = dir;
+  char 	  *tok;
+  char     copy[ PATH_LIMIT ]; // tokenised, leaving path intact (so a syscall can be reissued)
+
+  strncpy( copy, path, PATH_LIMIT - 1 ); copy[ PATH_LIMIT - 1 ] = '\0';
+
+  for (tok = strtok( copy, "/" ); 
+	     tok != NULL && ino != -1; 
+	     tok = strtok( NULL, "/" ) ) 
+  {
+    ino = dirLookup( ino, tok );
+  }
+
+  return ino;
+}
+
+// this version also deals with creating new files
+int path_to_ino2( char *path, const int dir ) {
+	inode_t  inode;
+	int 		 ino0,  ino = dir;
+	char 	  *tok0, *tok;
+
+	for (tok0 = tok = strtok( (char*)path, "/" ); 
+			 tok != NULL && ino != -1; 
+			 tok = strtok( NULL, "/" ) ) 
+  {
+		ino0 = ino;                        // first iteration will give us root directory
+		ino  = dirLookup( ino, tok );      // if ino is valid, then there must exist a corresponding valid inode
+
+		tok0 = tok;                        // tok0 will be name of file upon termination, if path is valid
+	} 
 	
-	  dir_t dir[ 16 ];
+	if (tok != NULL && ino == -1) {
+		return -1; // path doesn't exist
+	}
+	else if (tok == NULL && ino == -1) {
+		// create new inode and return corresponding ino
+		if (getFreeInode( &inode ) == NULL) // check assigned inode correctly
+			return -2;
+
+    // its data starts out inline, so it has no data block as yet
+    inode.i_ic.ic_flags = IC_INLINE;
+    writeInode( &inode );
+
+		// add new inode to parent directory (assumes new inode is not a directory)
+		inode_t parent;
+		readInode( &parent, ino0 );
+		addInodeToDirectory( &parent, inode.i_number, tok0 ); // TODO: parent will get written to 
+                                                          // - thus assumes parent is not in AIT (since is a dir.)
+
+		return inode.i_number;
+	}
+
+  return ino; 
+}
+
+// === DIRECTORIES FUNCTIONS ===
+
+void addInodeToDirectory( inode_t* par, uint32_t ino, const char *name ) {
+  const int r	= (par->i_ic.ic_size / 32) % 16; // offset in block
+  if (r == 0 && par->i_ic.ic_size > 0) {
+    allocateDataBlockAddr( par, par->i_ic.ic_size ); // TODO: validate
+  }
+  
+  dir_t dir[ 16 ];
+  daddr32_t addr = getDataBlock( (uint8_t*)dir, par, par->i_ic.ic_size );
+
+  memset( &dir[ r ], 0, sizeof( dir_t ) ); // the block may be reused, so the name is terminated afresh
+  dir[ r ].d_ino    = ino;
+  dir[ r ].d_namlen = strlen( name ); // TODO: pass in string length (it's safer that way)
+  strncpy( dir[ r ].d_name, name, strlen( name ) ); 
+	bcache_wr( addr, (uint8_t*)dir, BLOCK_SIZE );
+
+  // WARNING: this may need to go above getDataBlock?
+  par->i_ic.ic_size += 32; // add new directory
+  dirIndexAdd( par, name, par->i_ic.ic_size / 32 - 1 );
+  writeInode( par );       // update inode status on disk
+
+  dforget( par->i_number, name, strlen( name ) );
+}
+
+// === TABLE FUNCTIONS ===
+
+int getFD() {
+  // find valid file descriptor table entry
+  for (int fd = 0; fd < FDT_LIMIT; fd++) {
+    if (current->fd[ fd ] == NULL)
+      return fd;
+  }
+
+  return -1; // table full 
+}
+
+ofile_t * getOFT() {
+  // find valid OFT entry and grab the pointer to it
+	for (int i = 0; i < OFT_LIMIT; i++) {
+		if (of[ i ].o_inptr == NULL)
+			return &of[ i ];
+	}
+
+  return NULL; // this probably can't happen
+}
+
+// === POSIX FUNCTIONS ===
+
+int open( char *path, int oflag) {
+  int fd = getFD();                          if (fd == -1)      return -1;
+	int ino = 0;
+  if (oflag == O_CREAT) ino = path_to_ino2( path, ROOT_DIR );  
+  else                  ino = path_to_ino( path, ROOT_DIR );
+  if (ino < 0) return -1;
+  inode_t *inode = iget( ino );              if (inode == NULL) return -1; 
+  ofile_t *ofile = getOFT();                 if (ofile == NULL) return -1;
+
+  // increment number of linked OFT entries to the inode
+  inode->i_links++;	
+
+	// link FDT entry to OFT entry
+	current->fd[ fd ] = ofile;
+
+	// link OFT entry to (cached) inode
+	ofile->o_inptr = inode;	
+
+  return fd;
+}
+
+int close( const int fd ) {
+  // validation
+  if      (fd < 0 || fd >= FDT_LIMIT) return -1;
+  else if (current->fd[ fd ] == NULL) return -1;
+
+  // asynchronous requests queued on it are carried out first
+  if (aioPending( -1, current->fd[ fd ] ))
+    aioService( 1 );
+  
+  // decrement i_link THEN check it is 0 
+  if (--current->fd[ fd ]->o_inptr->i_links == 0) {
+    // no longer open, so may be evicted (once written back)
+    writeInode( current->fd[ fd ]->o_inptr );
+  }
+
+  // clear OFT entry
+  current->fd[ fd ]->o_inptr = NULL;
+  current->fd[ fd ]->o_head  = 0;
+  current->fd[ fd ]->o_ranext = current->fd[ fd ]->o_rawin = current->fd[ fd ]->o_raend = 0;
+  current->fd[ fd ]->o_mlen   = 0;
+
+  // clear FDT entry
+  current->fd[ fd ] = NULL;
+
+  return 0;
+}
+
+int fwrite( const int fd, const uint8_t *data, const int n ) {
+  // validation
+  if      (fd < 0 || fd >= FDT_LIMIT) return -1;
+  else if (current->fd[ fd ] == NULL) return -1;
+
+  ofile_t *ofile = current->fd[ fd ];
+  inode_t *inode = ofile->o_inptr;
+
+  // if necessary, allocate new blocks to file (any skipped over left as a hole)
+  if (extendFile( inode, ofile->o_head, ofile->o_head + n ) == -1)
+    return -1;
+
+  // inline data (that still fits, see allocateDataBlocks) is written to the inode
+  if (inode->i_ic.ic_flags & IC_INLINE) {
+    memcpy( inode->i_ic.ic_data + ofile->o_head, data, n );
+    writeInode( inode );
+
+    ofile->o_head += n;
+    return 0;
+  }
+
+  daddr32_t a[ BATCH_LIMIT ], pa[ 2 ]; // block addrs (all, and partially written ones)
+  buf_t    *pb[ 2 ];
+  int       off[ BATCH_LIMIT ], len[ BATCH_LIMIT ];
+
+  // up to BATCH_LIMIT segments (each a whole block, or part of one) at a time
+  for (int i = 0; i < n; ) {
+    int m = 0, p = 0, k = i;
+
+    for (; m < BATCH_LIMIT && i < n; m++) {
+      off[ m ] = (ofile->o_head + i) % BLOCK_SIZE;
+      len[ m ] = BLOCK_SIZE - off[ m ] < n - i ? BLOCK_SIZE - off[ m ] : n - i;
+      a[ m ]   = getFileBlockAddr( ofile, ofile->o_head + i );
+
+      if ((a[ m ] == 0 || bshared( a[ m ] )) && (a[ m ] = ownBlock( inode, (ofile->o_head + i) / BLOCK_SIZE, len[ m ] != BLOCK_SIZE )) == -1)
+        return -1;
+
+      if (len[ m ] != BLOCK_SIZE)
+        pa[ p++ ] = a[ m ];
+
+      i += len[ m ];
+    }
+
+    // only partially written blocks are read, then patched in the cache; whole ones are just overwritten
+    breadn( pa, pb, p );
+
+    for (int j = 0, q = 0; j < m; k += len[ j++ ]) {
+      buf_t *b = len[ j ] == BLOCK_SIZE ? bget( a[ j ] ) : pb[ q++ ];
+
+      memcpy( b->b_data + off[ j ], data + k, len[ j ] );
+      bdirty( b );
+    }
+  }
+
+  ofile->o_head += n;
+
+  return 0;
+}
+
+/* Sequential reads of a file (i.e., each starting where the last one
+ * ended) double its read-ahead window, up to RA_LIMIT blocks, whereas
+ * any other read closes it. Once less than half the window lies read
+ * ahead of the reader, the rest is fetched in one go (along with the
+ * blocks being read, if they fit): the reader doesn't wait for it, but
+ * finds it cached by the time it gets there.
+ *
+ * The window is passed in, rather than updated here, since a read that
+ * waits on the disk is reissued: fread only updates the open file once
+ * the read is done. Returns the new o_raend.
+ */
+uint32_t readAhead( ofile_t *ofile, const int n, const uint32_t win ) {
+  const inode_t *inode = ofile->o_inptr;
+
+  const uint32_t first = ofile->o_head / BLOCK_SIZE;                             // first block being read
+  const uint32_t last  = (ofile->o_head + n - 1) / BLOCK_SIZE;                   // last  block being read
+  const uint32_t nblk  = (inode->i_ic.ic_size + BLOCK_SIZE - 1) / BLOCK_SIZE;    // blocks in file
+  const uint32_t from  = ofile->o_raend > last + 1 ? ofile->o_raend : last + 1;  // first block not read ahead
+  const uint32_t to    = last + 1 + win < nblk ? last + 1 + win : nblk;          // end of window
+
+  if (win == 0 || n <= 0)
+    return 0;
+  if (from >= to || from - (last + 1) >= win / 2)
+    return from;
+
+  daddr32_t a[ BATCH_LIMIT ];
+  int       m = 0, k;
+
+  if ((last - first + 1) + (to - from) <= BATCH_LIMIT) {
+    for (uint32_t i = first; i <= last; i++)
+      a[ m++ ] = getFileBlockAddr( ofile, i * BLOCK_SIZE );
+  }
+
+  k = m;
+  for (uint32_t i = from; i < to; i++)
+    a[ m++ ] = getFileBlockAddr( ofile, i * BLOCK_SIZE );
+
+  prefetchBlocks( a, m, k );
+
+  return to;
+}
+
+int fread( const int fd, uint8_t *data, const int n ) {
+  // validation
+  if      (fd < 0 || fd >= FDT_LIMIT) return -1;
+  else if (current->fd[ fd ] == NULL) return -1;
+
+  ofile_t *ofile = current->fd[ fd ];
+  inode_t *inode = ofile->o_inptr;
+
+  // Not enough data in file to be read
+  if (ofile->o_head + n > inode->i_ic.ic_size)
+    return -1;
+
+  // inline data is read from the inode
+  if (inode->i_ic.ic_flags & IC_INLINE) {
+    memcpy( data, inode->i_ic.ic_data + ofile->o_head, n );
+
+    ofile->o_head  += n;
+    ofile->o_ranext = ofile->o_head;
+    return 0;
+  }
+
+  // sequential reads grow the read-ahead window
+  uint32_t win = 0;
+  if (ofile->o_head == ofile->o_ranext)
+    win = ofile->o_rawin == 0 ? RA_INIT : ofile->o_rawin * 2 < RA_LIMIT ? ofile->o_rawin * 2 : RA_LIMIT;
+
+  const uint32_t raend = readAhead( ofile, n, win );
+
+  daddr32_t a[ BATCH_LIMIT ]; // block addrs
+  buf_t    *b[ BATCH_LIMIT ];
+  int       off[ BATCH_LIMIT ], len[ BATCH_LIMIT ];
+
+  // up to BATCH_LIMIT segments (each a whole block, or part of one) at a time, copied straight out of the cache
+  for (int i = 0; i < n; ) {
+    int m = 0, k = i;
+
+    for (; m < BATCH_LIMIT && i < n; m++) {
+      off[ m ] = (ofile->o_head + i) % BLOCK_SIZE;
+      len[ m ] = BLOCK_SIZE - off[ m ] < n - i ? BLOCK_SIZE - off[ m ] : n - i;
+      a[ m ]   = getFileBlockAddr( ofile, ofile->o_head + i );
+
+      i += len[ m ];
+    }
+
+    breadn( a, b, m );
+
+    for (int j = 0; j < m; k += len[ j++ ]) {
+      memcpy( data + k, b[ j ]->b_data + off[ j ], len[ j ] );
+    }
+  }
+
+  ofile->o_head  += n;
+  ofile->o_ranext = ofile->o_head;
+  ofile->o_rawin  = win;
+  ofile->o_raend  = raend;
+
+  return 0;
+}
+
+/* Whole blocks sent from one file to another are copied by the disk
+ * itself (see disk_copy): only the block maps change on the wire, so
+ * sending a file of any length to a file costs a handful of requests.
+ */
+
+// send k whole blocks of in, from byte pos on, to the head of out (both at a block boundary); returns bytes sent
+uint32_t sendBlocks( ofile_t *out, ofile_t *in, uint32_t pos, int k ) {
+  inode_t *inode = out->o_inptr;
+  daddr32_t s[ COPY_LIMIT ], d[ COPY_LIMIT ];
+  int       i = 0;
+
+  const uint32_t old = inode->i_ic.ic_size;
+
+  if (extendFile( inode, out->o_head, out->o_head + k * BLOCK_SIZE ) == -1)
+    return 0;
+
+  while (i < k) {
+    int m = 0;
+
+    for (; m < COPY_LIMIT && i + m < k; m++) {
+      const uint32_t blk = out->o_head / BLOCK_SIZE + i + m;
+
+      s[ m ] = getFileBlockAddr( in, pos + (i + m) * BLOCK_SIZE );
+      d[ m ] = getFileBlockAddr( out, blk * BLOCK_SIZE );
+
+      if ((d[ m ] == 0 || bshared( d[ m ] )) && (d[ m ] = ownBlock( inode, blk, 0 )) == -1)
+        break;
+    }
+
+    copyBlocks( s, d, m );
+    i += m;
+
+    if (m < COPY_LIMIT && i < k)
+      break; // out of space
+  }
+
+  // a short send gives back what the file grew by for the blocks not sent
+  const uint32_t end = out->o_head + i * BLOCK_SIZE;
+  if (i < k && inode->i_ic.ic_size > old)
+    truncateInode( inode, i > 0 && end > old ? end : old );
+
+  out->o_head += i * BLOCK_SIZE;
+
+  return i * BLOCK_SIZE;
+}
+
+/* sendfile copies count bytes (or as many as there are) of the file open
+ * as in, from *offset (advancing it) or, if offset is NULL, from its head
+ * (as read would), to STDIO or to the file open as out, without the data
+ * going via user space. A batch of blocks at a time is read through the
+ * cache, then written to the console straight out of its buffers, or
+ * gathered into the staging blocks and written to out by a single fwrite.
+ * Returns the number of bytes sent, -1 if a file isn't open or nothing
+ * could be written.
+ */
+
+int sendfile( const int out, const int in, uint32_t *offset, uint32_t count ) {
+  // validation
+  if      (in < 0 || in >= FDT_LIMIT || current->fd[ in ] == NULL)                    return -1;
+  else if (out != STDIO && (out < 0 || out >= FDT_LIMIT || current->fd[ out ] == NULL)) return -1;
+  else if (out != STDIO && current->fd[ out ] == current->fd[ in ])                     return -1; // one head for both
+
+  ofile_t *ofile = current->fd[ in ];
+  inode_t *inode = ofile->o_inptr;
+
+  const uint32_t pos = offset != NULL ? *offset : ofile->o_head;
+  const uint32_t end = inode->i_ic.ic_size;
+
+  if (pos >= end)             count = 0;
+  else if (count > end - pos) count = end - pos;
+
+  const uint8_t *x[ BATCH_LIMIT ];
+  int            len[ BATCH_LIMIT ];
+  uint32_t       sent = 0;
+
+  // whole blocks between two block aligned files go by copy, and only the rest through here
+  if (out != STDIO && current->fd[ out ]->o_inptr != inode && !(inode->i_ic.ic_flags & IC_INLINE) &&
+      pos % BLOCK_SIZE == 0 && current->fd[ out ]->o_head % BLOCK_SIZE == 0 && count >= BLOCK_SIZE) {
+    sent = sendBlocks( current->fd[ out ], ofile, pos, count / BLOCK_SIZE );
+  }
+
+  // up to BATCH_LIMIT segments (each a whole block, or part of one) at a time
+  while (sent < count) {
+    int m = 0;
+
+    // inline data is sent from the inode
+    if (inode->i_ic.ic_flags & IC_INLINE) {
+      x[ 0 ] = inode->i_ic.ic_data + pos;
+      len[ 0 ] = count;
+      m = 1;
+    }
+    else {
+      daddr32_t a[ BATCH_LIMIT ];
+      buf_t    *b[ BATCH_LIMIT ];
+      int       off[ BATCH_LIMIT ];
+
+      for (uint32_t i = sent; m < BATCH_LIMIT && i < count; m++) {
+        off[ m ] = (pos + i) % BLOCK_SIZE;
+        len[ m ] = BLOCK_SIZE - off[ m ] < count - i ? BLOCK_SIZE - off[ m ] : count - i;
+        a[ m ]   = getFileBlockAddr( ofile, pos + i );
+
+        i += len[ m ];
+      }
+
+      breadn( a, b, m );
+
+      for (int j = 0; j < m; j++) {
+        x[ j ] = b[ j ]->b_data + off[ j ];
+      }
+    }
+
+    if (out == STDIO) {
+      for (int j = 0; j < m; sent += len[ j++ ]) {
+        for (int k = 0; k < len[ j ]; k++)
+          PL011_putc( UART0, x[ j ][ k ] );
+      }
+    }
+    else {
+      // fwrite may claim the buffers read (or overwrite them, if out is in), so the batch is copied out first
+      int n = 0;
+      for (int j = 0; j < m; n += len[ j++ ]) {
+        memcpy( batch[ 0 ] + n, x[ j ], len[ j ] );
+      }
+
+      // fwrite grows out before writing, so a failed batch gives back what it grew by, and isn't sent
+      inode_t       *oinode = current->fd[ out ]->o_inptr;
+      const uint32_t size   = oinode->i_ic.ic_size;
+
+      if (fwrite( out, batch[ 0 ], n ) == -1) {
+        if (oinode->i_ic.ic_size > size)
+          truncateInode( oinode, size );
+        break;
+      }
+
+      sent += n;
+    }
+  }
+
+  if (offset != NULL) *offset     += sent;
+  else                ofile->o_head += sent;
+
+  return sent == 0 && count > 0 ? -1 : sent;
+}
+
+/* A reflink copies a file without copying any data: the new file maps
+ * the very same data blocks, each of which gains a reference (fs_rcnt),
+ * so bfree only gives one back once no file maps it. A shared block is
+ * never written to: the first write to it, by either file, goes to a
+ * block of its own instead (see ownBlock), leaving the other untouched.
+ * Only inline and extent mapped files can be reflinked.
+ */
+
+// make the file open as out a copy of that open as in, sharing its data blocks; 0 on success, -1 on failure
+int reflink( const int out, const int in ) {
+  // validation
+  if      (in  < 0 || in  >= FDT_LIMIT || current->fd[ in  ] == NULL) return -1;
+  else if (out < 0 || out >= FDT_LIMIT || current->fd[ out ] == NULL) return -1;
+
+  inode_t   *src = current->fd[ in  ]->o_inptr;
+  inode_t   *dst = current->fd[ out ]->o_inptr;
+  icommon_t *ic  = &src->i_ic;
+
+  if (src->i_number == dst->i_number || ic->ic_mode != IFREG || dst->i_ic.ic_mode != IFREG)
+    return -1;
+  if (!(ic->ic_flags & (IC_INLINE | IC_EXTENTS)) || ((ic->ic_flags & IC_EXTENTS) && fs.fs_rcblkno == 0))
+    return -1; // no way to share its blocks
+
+  // every block must be able to take another reference
+  for (int i = 0; (ic->ic_flags & IC_EXTENTS) && i < (int)ic->ic_next; i++) {
+    const extent_t e = readExtent( src, i );
+
+    for (uint32_t j = 0; j < e.e_len && e.e_start != 0; j++) {
+      if (fs_rcnt[ e.e_start + j ] == RCNT_MAX)
+        return -1;
+    }
+  }
+
+  // out gives up every block it has
+  truncateBlocks( dst, 0 );
+  memset( dst->i_ic.ic_data, 0, IDATA_LIMIT );
+  dst->i_ic.ic_flags = ic->ic_flags;
+  dst->i_ic.ic_size  = ic->ic_size;
+
+  if (ic->ic_flags & IC_INLINE) {
+    memcpy( dst->i_ic.ic_data, ic->ic_data, IDATA_LIMIT );
+  }
+  else {
+    if (ic->ic_next > NEXTENT) {
+      int xb = balloc();
+      if (xb == -1) {
+        dst->i_ic.ic_flags = IC_INLINE;
+        dst->i_ic.ic_size  = 0;
+        writeInode( dst );
+        return -1;
+      }
+
+      buf_t *b = bget( xb ); // new, so nothing to read
+      memset( b->b_data, 0, BLOCK_SIZE );
+      bdirty( b );
+      dst->i_ic.ic_xb = xb;
+    }
 
-	  for (int i = 0; i < blks-1; i++) {
-      getDataBlock( (uint8_t*)dir, in, BLOCK_SIZE * i );
-		  for (int j = 0; j < 16; j++) {
-			  if (strncmp( name, dir[j].d_name, dir[j].d_namlen >= strlen(name) ? dir[j].d_namlen : strlen(name) ) == 0)
-				  return dir[j].d_ino;
-		  }
-	  }
+    dst->i_ic.ic_next = ic->ic_next;
+    for (int i = 0; i < (int)ic->ic_next; i++) {
+      const extent_t e = readExtent( src, i );
+      writeExtent( dst, i, e );
 
-    getDataBlock( (uint8_t*)dir, in, BLOCK_SIZE * (blks-1) );
-	  for (int j = 0; j < r; j++) {
-		  if (strncmp( name, dir[j].d_name, dir[j].d_namlen >= strlen(name) ? dir[j].d_namlen : strlen(name) ) == 0)
-			  return dir[j].d_ino;
-	  }
+      for (uint32_t j = 0; j < e.e_len && e.e_start != 0; j++)
+        fs_rcnt[ e.e_start + j ]++;
+    }
+
+    rcdirty();
   }
 
-	return -1; // does not exist in directory
+  dst->i_gen++;
+  writeInode( dst );
+
+  current->fd[ out ]->o_head = 0;
+  return 0;
 }
 
-int path_to_ino( char *path, const int dir ) {
-  inode_t  inode;
-  int 		 ino = dir;
-  char 	  *tok;
+/* Positional, vectored I/O: each segment names its own offset, so records
+ * scattered through a file are read or written in one syscall, and the
+ * head of the open file doesn't move. Segments are split into pieces at
+ * block boundaries and applied in order, a batch of up to BATCH_LIMIT
+ * distinct blocks at a time, so every piece landing in the same block
+ * shares one lookup (and one read, should it miss the cache). Blocks a
+ * write covers entirely aren't read at all.
+ */
+
+// apply pieces p to the nb blocks at addresses a (whole[ s ] iff. a piece written covers block s)
+void transferPieces( const daddr32_t *a, const int *whole, int nb, const piece_t *p, int np, const int w ) {
+  daddr32_t ra[ BATCH_LIMIT ]; // blocks to read
+  buf_t    *b[ BATCH_LIMIT ], *rb[ BATCH_LIMIT ];
+  int       rs[ BATCH_LIMIT ], nr = 0;
+
+  for (int s = 0; s < nb; s++) {
+    if (!w || !whole[ s ]) {
+      ra[ nr ] = a[ s ]; rs[ nr++ ] = s;
+    }
+  }
 
-  for (tok = strtok( path, "/" ); 
-	     tok != NULL && ino != -1; 
-	     tok = strtok( NULL, "/" ) ) 
-  {
-    readInode( &inode, ino );
-    ino = name_to_ino( tok, &inode );
+  breadn( ra, rb, nr );
+
+  for (int k = 0; k < nr; k++) {
+    b[ rs[ k ] ] = rb[ k ];
+  }
+  for (int s = 0; s < nb; s++) {
+    if (w && whole[ s ])
+      b[ s ] = bget( a[ s ] );
   }
 
-  return ino;
+  for (int j = 0; j < np; j++) {
+    if (w) memcpy( b[ p[ j ].p_slot ]->b_data + p[ j ].p_off, p[ j ].p_buf, p[ j ].p_len );
+    else   memcpy( p[ j ].p_buf, b[ p[ j ].p_slot ]->b_data + p[ j ].p_off, p[ j ].p_len );
+  }
+
+  if (w) {
+    for (int s = 0; s < nb; s++)
+      bdirty( b[ s ] );
+  }
 }
 
-// this version also deals with creating new files
-int path_to_ino2( char *path, const int dir ) {
-	inode_t  inode;
-	int 		 ino0,  ino = dir;
-	char 	  *tok0, *tok;
+// read (w = 0) or write (w = 1) the cnt segments iov of an open file; -1 if a read would pass the end (transferring nothing)
+int transferFile( ofile_t *ofile, const iovec_t *iov, const int cnt, const int w ) {
+  inode_t *inode = ofile->o_inptr;
 
-	for (tok0 = tok = strtok( (char*)path, "/" ); 
-			 tok != NULL && ino != -1; 
-			 tok = strtok( NULL, "/" ) ) 
-  {
-		readInode( &inode, ino ); 			     // first iteration will give us root directory
+  uint32_t end = 0;
+  for (int i = 0; i < cnt; i++) {
+    if (iov[ i ].iov_off + iov[ i ].iov_len < iov[ i ].iov_off)
+      return -1; // past the largest offset there is
 
-		ino0 = ino;
-		ino  = name_to_ino( tok, &inode ); // if ino is valid, then there must exist a corresponding valid inode
+    if (iov[ i ].iov_len > 0 && iov[ i ].iov_off + iov[ i ].iov_len > end)
+      end = iov[ i ].iov_off + iov[ i ].iov_len;
+  }
 
-		tok0 = tok;                        // tok0 will be name of file upon termination, if path is valid
-	} 
-	
-	if (tok != NULL && ino == -1) {
-		return -1; // path doesn't exist
-	}
-	else if (tok == NULL && ino == -1) {
-		// create new inode and return corresponding ino
-		if (getFreeInode( &inode ) == NULL) // check assigned inode correctly
-			return -2;
+  // reads must lie within the file, writes past its end first grow it (a lone segment's blocks allocated, any others filled in as written)
+  if (end > inode->i_ic.ic_size) {
+    if (!w || extendFile( inode, cnt == 1 ? iov[ 0 ].iov_off : end, end ) == -1)
+      return -1;
+  }
 
-    // give inode its first data block
-    inode.i_ic.ic_db[ 0 ] = balloc();
+  // inline data (that still fits, see allocateDataBlocks) is in the inode
+  if (inode->i_ic.ic_flags & IC_INLINE) {
+    for (int i = 0; i < cnt; i++) {
+      if (w) memcpy( inode->i_ic.ic_data + iov[ i ].iov_off, iov[ i ].iov_base, iov[ i ].iov_len );
+      else   memcpy( iov[ i ].iov_base, inode->i_ic.ic_data + iov[ i ].iov_off, iov[ i ].iov_len );
+    }
 
-    // write new inode to disk
-    writeInode( &inode );
+    if (w)
+      writeInode( inode );
+    return 0;
+  }
 
-		// add new inode to parent directory (assumes new inode is not a directory)
-		inode_t parent;
-		readInode( &parent, ino0 );
-		addInodeToDirectory( &parent, inode.i_number, tok0 ); // TODO: parent will get written to 
-                                                          // - thus assumes parent is not in AIT (since is a dir.)
+  daddr32_t a[ BATCH_LIMIT ];
+  int       whole[ BATCH_LIMIT ], nb = 0, np = 0;
+  piece_t   p[ IOV_PIECES ];
 
-		return inode.i_number;
-	}
+  for (int i = 0; i < cnt; i++) {
+    for (uint32_t done = 0; done < iov[ i ].iov_len; ) {
+      const uint32_t pos  = iov[ i ].iov_off + done;
+      int            addr = getFileBlockAddr( ofile, pos );
 
-  return ino; 
-}
+      if (addr == -1)
+        return -1;
+      if (w && (addr == 0 || bshared( addr )) && (addr = ownBlock( inode, pos / BLOCK_SIZE, 1 )) == -1)
+        return -1;
 
-// === DIRECTORIES FUNCTIONS ===
+      int s = 0;
+      while (s < nb && a[ s ] != addr) s++;
 
-void addInodeToDirectory( inode_t* par, uint32_t ino, const char *name ) {
-  const int r	= (par->i_ic.ic_size / 32) % 16; // offset in block
-  if (r == 0 && par->i_ic.ic_size > 0) {
-    allocateDataBlockAddr( par, par->i_ic.ic_size ); // TODO: validate
-  }
-  
-  dir_t dir[ 16 ];
-  daddr32_t addr = getDataBlock( (uint8_t*)dir, par, par->i_ic.ic_size );
+      // no room for the piece (or its block) in this batch: apply it first
+      if ((s == nb && nb == BATCH_LIMIT) || np == IOV_PIECES) {
+        transferPieces( a, whole, nb, p, np, w );
+        s = nb = np = 0;
+      }
 
-  dir[ r ].d_ino    = ino;
-  dir[ r ].d_namlen = strlen( name ); // TODO: pass in string length (it's safer that way)
-  strncpy( dir[ r ].d_name, name, strlen( name ) ); 
-	disk_wr( addr, (uint8_t*)dir, BLOCK_SIZE );
+      if (s == nb) {
+        a[ nb ] = addr; whole[ nb++ ] = 0;
+      }
 
-  // WARNING: this may need to go above getDataBlock?
-  par->i_ic.ic_size += 32; // add new directory
-  writeInode( par );       // update inode status on disk
-}
+      p[ np ].p_slot = s;
+      p[ np ].p_off  = pos % BLOCK_SIZE;
+      p[ np ].p_len  = BLOCK_SIZE - p[ np ].p_off < iov[ i ].iov_len - done ? BLOCK_SIZE - p[ np ].p_off : iov[ i ].iov_len - done;
+      p[ np ].p_buf  = (uint8_t*)iov[ i ].iov_base + done;
 
-// === TABLE FUNCTIONS ===
+      if (p[ np ].p_len == BLOCK_SIZE)
+        whole[ s ] = 1;
 
-int getFD() {
-  // find valid file descriptor table entry
-  for (int fd = 0; fd < FDT_LIMIT; fd++) {
-    if (current->fd[ fd ] == NULL)
-      return fd;
+      done += p[ np++ ].p_len;
+    }
   }
 
-  return -1; // table full 
+  transferPieces( a, whole, nb, p, np, w );
+
+  return 0;
 }
 
-ofile_t * getOFT() {
-  // find valid OFT entry and grab the pointer to it
-	for (int i = 0; i < OFT_LIMIT; i++) {
-		if (of[ i ].o_inptr == NULL)
-			return &of[ i ];
-	}
+// read (w = 0) or write (w = 1) the cnt segments iov of the file open as fd (see transferFile)
+int transferv( const int fd, const iovec_t *iov, const int cnt, const int w ) {
+  // validation
+  if      (fd < 0 || fd >= FDT_LIMIT || cnt < 0) return -1;
+  else if (current->fd[ fd ] == NULL)            return -1;
 
-  return NULL; // this probably can't happen
+  return transferFile( current->fd[ fd ], iov, cnt, w );
 }
 
-inode_t * getAIT( int ino ) {
-  // inode already in AIT
-	for (int i = 0; i < AIT_LIMIT; i++) {
-		if (ai[ i ].i_number == ino && ai[ i ].i_ic.ic_mode != IFZERO)
-			return &ai[ i ];
-	}	
+int fpread( const int fd, uint8_t *data, const int n, uint32_t offset ) {
+  const iovec_t iov = { offset, data, n };
+  return transferv( fd, &iov, 1, 0 );
+}
 
-  // add inode to empty AIT entry (2nd pass)
-  for (int i = 0; i < AIT_LIMIT; i++) {
-    if (ai[ i ].i_ic.ic_mode == IFZERO)
-      return readInode( &ai[ i ], ino );
-	}	
+int fpwrite( const int fd, const uint8_t *data, const int n, uint32_t offset ) {
+  const iovec_t iov = { offset, (uint8_t*)data, n };
+  return transferv( fd, &iov, 1, 1 );
+}
 
-	return NULL; // table full
+int freadv( const int fd, const iovec_t *iov, const int cnt ) {
+  return transferv( fd, iov, cnt, 0 );
 }
 
-// === POSIX FUNCTIONS ===
+int fwritev( const int fd, const iovec_t *iov, const int cnt ) {
+  return transferv( fd, iov, cnt, 1 );
+}
 
-int open( char *path, int oflag) {
-  int fd = getFD();                          if (fd == -1)      return -1;
-	int ino = 0;
-  if (oflag == O_CREAT) ino = path_to_ino2( path, ROOT_DIR );  
-  else                  ino = path_to_ino( path, ROOT_DIR );
-  if (ino < 0) return -1;
-  inode_t *inode = getAIT( ino );            if (inode == NULL) return -1; 
-  ofile_t *ofile = getOFT();                 if (ofile == NULL) return -1;
+/* Asynchronous I/O: aio_read / aio_write / aio_fsync queue a request and
+ * return at once, and the caller carries on while the blocks a read needs
+ * are fetched in the background. Requests are carried out in the order
+ * queued, each once none of the blocks it reads is still on its way from
+ * the disk, and always in SVC context: at the end of the first syscall
+ * after a background read completes, and as a process asks its message
+ * queue for completions (sleeping until the disk or a completion wakes
+ * it, unless nothing else could run meanwhile). Each
+ * then posts a completion (its tag and result) to the message queue the
+ * caller named, where a single msgreceive collects as many as it has room
+ * for. A queue holds up to MQ_AIO_LIMIT; the rest wait in line until it
+ * has room. Closing a file first carries out every request queued on it;
+ * killing or exec'ing a process fails those it queued and that are still
+ * to be carried out, as its buffers go with it.
+ */
+
+aio_t aioq[ AIO_LIMIT ]; int aio_head, aio_n; // queued requests (a ring, oldest first)
+
+// queue a request of type op, as set out by cb; 0 on success, -1 on failure
+int aio_submit( aioop_t op, const aiocb_t *cb ) {
+  // validation
+  if      (cb == NULL || aio_n == AIO_LIMIT)                                                        return -1;
+  else if (cb->aio_fd < 0 || cb->aio_fd >= FDT_LIMIT || current->fd[ cb->aio_fd ] == NULL)          return -1;
+  else if (cb->aio_mqd < 0 || cb->aio_mqd >= MSGCHAN_LIMIT || mq[ cb->aio_mqd ].msg_qname == 0)    return -1;
+  else if (op != AIO_FSYNC && cb->aio_offset + cb->aio_nbytes < cb->aio_offset)                    return -1;
 
-  // increment number of linked OFT entries to the inode
-  inode->i_links++;	
+  ofile_t *ofile = current->fd[ cb->aio_fd ];
+  inode_t *inode = ofile->o_inptr;
+  aio_t   *r     = &aioq[ (aio_head + aio_n++) % AIO_LIMIT ];
 
-	// link FDT entry to OFT entry
-	current->fd[ fd ] = ofile;
+  r->a_op    = op;
+  r->a_pid   = current->pid;
+  r->a_ofile = op == AIO_FSYNC ? NULL : ofile;
+  r->a_cb    = *cb;
+  r->a_done  = 0;
 
-	// link OFT entry to AIT entry
-	ofile->o_inptr = inode;	
+  // the blocks it reads are fetched meanwhile (as many as fit a batch, the rest once it's carried out)
+  if (op == AIO_READ && !(inode->i_ic.ic_flags & IC_INLINE) && cb->aio_offset + cb->aio_nbytes <= inode->i_ic.ic_size) {
+    daddr32_t a[ BATCH_LIMIT ];
+    int       m = 0;
 
-  return fd;
-}
+    for (uint32_t pos = cb->aio_offset - cb->aio_offset % BLOCK_SIZE; pos < cb->aio_offset + cb->aio_nbytes && m < BATCH_LIMIT; pos += BLOCK_SIZE)
+      a[ m++ ] = getFileBlockAddr( ofile, pos );
 
-int close( const int fd ) {
-  // validation
-  if      (fd < 0 || fd >= FDT_LIMIT) return -1;
-  else if (current->fd[ fd ] == NULL) return -1;
-  
-  // decrement i_link THEN check it is 0 
-  if (--current->fd[ fd ]->o_inptr->i_links == 0) {
-    // no longer need to keep inode in memory
-    writeInode( current->fd[ fd ]->o_inptr );
-    current->fd[ fd ]->o_inptr->i_ic.ic_mode = IFZERO;
+    prefetchBlocks( a, m, m );
   }
 
-  // clear OFT entry
-  current->fd[ fd ]->o_inptr = NULL;
-  current->fd[ fd ]->o_head  = 0;
-
-  // clear FDT entry
-  current->fd[ fd ] = NULL;
-
   return 0;
 }
 
-int fwrite( const int fd, const uint8_t *data, const int n ) {
-  // validation
-  if      (fd < 0 || fd >= FDT_LIMIT) return -1;
-  else if (current->fd[ fd ] == NULL) return -1;
+// whether a request can be carried out without waiting on the disk, i.e., none of the blocks it reads is being fetched
+int aioReady( const aio_t *r ) {
+  const aiocb_t *cb    = &r->a_cb;
+  const inode_t *inode = r->a_ofile != NULL ? r->a_ofile->o_inptr : NULL;
 
-  ofile_t *ofile = current->fd[ fd ];
-  inode_t *inode = ofile->o_inptr;
+  if (r->a_op != AIO_READ || (inode->i_ic.ic_flags & IC_INLINE) || cb->aio_offset + cb->aio_nbytes > inode->i_ic.ic_size)
+    return 1;
 
-  // if necessary, allocate new blocks to file
-  if (ofile->o_head + n > inode->i_ic.ic_size)
-    allocateDataBlocks( inode, ofile->o_head + n - inode->i_ic.ic_size );
+  for (uint32_t pos = cb->aio_offset - cb->aio_offset % BLOCK_SIZE; pos < cb->aio_offset + cb->aio_nbytes; pos += BLOCK_SIZE) {
+    const int    a = getFileBlockAddr( r->a_ofile, pos );
+    const buf_t *b = a > 0 ? blookup( a ) : NULL;
 
-  uint8_t buf[ BLOCK_SIZE ]; // block buffer
-  uint32_t addr = getDataBlock( buf, inode, ofile->o_head ); // maintain current block addr
+    if (b != NULL && (b->b_flags & B_BUSY))
+      return 0;
+  }
 
-  // write each byte to disk
-  for (int i = 0; i < n; i++) {
-    buf[ (ofile->o_head + i) % BLOCK_SIZE ] = data[ i ];
-  
-    // check not last byte and next addr goes over block boundary
-    if (i != n-1 && (ofile->o_head + i + 1) % BLOCK_SIZE == 0) {
-      disk_wr( addr, buf, BLOCK_SIZE );                         // store
-      addr = getDataBlock( buf, inode, ofile->o_head + i + 1 ); // load                       
+  return 1;
+}
+
+// carry out queued requests in order (those ready, unless wait), then post the completions of those done
+void aioService( const int wait ) {
+  for (int i = 0; i < aio_n; i++) {
+    aio_t *r = &aioq[ (aio_head + i) % AIO_LIMIT ];
+
+    if (r->a_done)
+      continue;
+    if (!wait && !aioReady( r ))
+      break;
+
+    if (r->a_op == AIO_FSYNC) {
+      isync();
+      sbflush();
+      r->a_result = bsync() < 0 ? -1 : 0;
+    }
+    else {
+      const iovec_t iov = { r->a_cb.aio_offset, r->a_cb.aio_buf, r->a_cb.aio_nbytes };
+      r->a_result = transferFile( r->a_ofile, &iov, 1, r->a_op == AIO_WRITE ) == -1 ? -1 : (int)r->a_cb.aio_nbytes;
     }
+
+    r->a_done = 1;
   }
 
-  disk_wr( addr, buf, BLOCK_SIZE );
-  ofile->o_head += n;
+  // completions are posted in order too, each once its message queue has room
+  while (aio_n > 0 && aioq[ aio_head ].a_done) {
+    const aiocomp_t c = { aioq[ aio_head ].a_cb.aio_tag, aioq[ aio_head ].a_result };
 
-  return 0;
-}
+    if (mq_post( aioq[ aio_head ].a_cb.aio_mqd, &c ) == -1)
+      break;
 
-int fread( const int fd, uint8_t *data, const int n ) {
-  // validation
-  if      (fd < 0 || fd >= FDT_LIMIT) return -1;
-  else if (current->fd[ fd ] == NULL) return -1;
+    aio_head = (aio_head + 1) % AIO_LIMIT;
+    aio_n--;
+  }
+}
 
-  ofile_t *ofile = current->fd[ fd ];
-  inode_t *inode = ofile->o_inptr;
+// fail the requests a process queued that aren't yet carried out, as it's killed or exec'd (so its buffers are gone)
+void aioCancel( const int pid ) {
+  for (int i = 0; i < aio_n; i++) {
+    aio_t *r = &aioq[ (aio_head + i) % AIO_LIMIT ];
 
-  // Not enough data in file to be read
-  if (ofile->o_head + n > inode->i_ic.ic_size)
-    return -1;
+    if (r->a_pid == pid && !r->a_done) {
+      r->a_done   = 1;
+      r->a_result = -1;
+    }
+  }
+}
 
-  uint8_t buf[ BLOCK_SIZE ]; // block buffer
-  getDataBlock( buf, inode, ofile->o_head );
+// whether any queued request has yet to post to message queue mqd, or to be carried out on ofile (if not NULL)
+int aioPending( const int mqd, const ofile_t *ofile ) {
+  for (int i = 0; i < aio_n; i++) {
+    const aio_t *r = &aioq[ (aio_head + i) % AIO_LIMIT ];
 
-  // read each byte to from
-  for (int i = 0; i < n; i++) {
-    data[ i ] = buf[ (ofile->o_head + i) % BLOCK_SIZE ];
-  
-    // check not last byte and next addr goes over block boundary
-    if (i != n-1 && (ofile->o_head + i + 1) % BLOCK_SIZE == 0)
-      getDataBlock( buf, inode, (ofile->o_head + i + 1) );                
+    if (r->a_cb.aio_mqd == mqd || (ofile != NULL && r->a_ofile == ofile && !r->a_done))
+      return 1;
   }
 
-  ofile->o_head += n;
-
   return 0;
 }
 
@@ -1082,12 +3582,23 @@ int unlink(char *name) {
   readInode( &inode, cwd );
 
   if (remove( &dir, &inode, name ) != -1) { 
+    dpurge( dir.d_ino ); // its number may be reused
     readInode( &inode, dir.d_ino );
-    freeDataBlocks( &inode );
+    if (inode.i_ic.ic_flags & IC_DIRHASH) {
+      dirdot_t dot;
+      readDot( &inode, &dot );
+      dxDrop( &inode, &dot );
+    }
+    truncateBlocks( &inode, 0 );
     inode.i_ic.ic_mode = IFZERO;
     inode.i_ic.ic_size = 0;
     writeInode( &inode );  
 
+    if (fs.fs_nfil < FIL_LIMIT) {
+      fs.fs_fil[ fs.fs_nfil++ ] = inode.i_number;
+      sbdirty();
+    }
+
     return 0;
   }
 
@@ -1102,6 +3613,82 @@ int tell( const int fd ) {
   return current->fd[ fd ]->o_head;
 }
 
+int truncate( const int fd, uint32_t length ) {
+  // validate file descriptor
+  if (fd < 0 || fd >= FDT_LIMIT) return -1;
+  if (current->fd[ fd ] == NULL) return -1;
+
+  return truncateInode( current->fd[ fd ]->o_inptr, length );
+}
+
+int stat( char *path, stat_t *s ) {
+  const int ino = path_to_ino( path, cwd );
+  if (ino == -1) return -1;
+
+  inode_t inode;
+  readInode( &inode, ino );
+
+  s->st_ino    = ino;
+  s->st_mode   = inode.i_ic.ic_mode;
+  s->st_size   = inode.i_ic.ic_size;
+  s->st_blocks = 0;
+  s->st_runs   = 0;
+
+  // count the data blocks (holes have none), and where they stop being consecutive on disk
+  const int nblk = inode.i_ic.ic_flags & IC_INLINE ? 0 : inode.i_ic.ic_size / BLOCK_SIZE + 1; // as mapped (see allocateDataBlocks)
+
+  for (int i = 0, prev = -1; i < nblk; i++) {
+    const int a = getDataBlockAddr( &inode, i * BLOCK_SIZE );
+    if (a <= 0)
+      continue;
+
+    if (a != prev + 1)
+      s->st_runs++;
+    s->st_blocks++;
+    prev = a;
+  }
+
+  return 0;
+}
+
+/* getdents lists up to n entries of the directory at path into d, starting
+ * from entry *cookie (0 to start with) and leaving *cookie at the entry to
+ * resume from, so a whole directory takes a call per batch rather than one
+ * per name. Entries are numbered by their position in the directory, which
+ * remove changes (the last entry fills the hole), so a directory changed
+ * between calls may have entries listed twice or not at all.
+ */
+int getdents( char *path, uint32_t *cookie, dirent_t *d, const int n ) {
+  const int ino = path_to_ino( path, cwd );
+  if (ino == -1) return -1;
+
+  inode_t dir;
+  readInode( &dir, ino );
+  if (dir.i_ic.ic_mode != IFDIR) return -1;
+
+  const uint32_t dirs = dir.i_ic.ic_size / 32;
+  uint32_t e = *cookie;
+  int m = 0;
+
+  for (; e < dirs && m < n; e++, m++) {
+    dir_t ent; // copied, as reading the child's inode may evict the directory block
+    memcpy( &ent, dirEntry( &dir, e ), sizeof( dir_t ) );
+
+    inode_t child;
+    readInode( &child, ent.d_ino );
+
+    d[ m ].d_ino    = ent.d_ino;
+    d[ m ].d_size   = child.i_ic.ic_size;
+    d[ m ].d_mode   = child.i_ic.ic_mode;
+    d[ m ].d_namlen = ent.d_namlen > MAXNAMLEN ? MAXNAMLEN : ent.d_namlen;
+    memcpy( d[ m ].d_name, ent.d_name, d[ m ].d_namlen );
+    d[ m ].d_name[ d[ m ].d_namlen ] = '\0';
+  }
+
+  *cookie = e;
+  return m;
+}
+
 // =====================================
 // === INTERRUPTS / SUPERVISOR CALLS ===
 // =====================================
@@ -1122,14 +3709,39 @@ void kernel_handler_rst( ctx_t* ctx ) {
   rq_size = 0;
   rq_add( 0 );
 
+  // negotiate binary transfers with the disk (falls back to hex)
+  disk_init();
+
+  bcache_init();
+  icache_init();
+  dcache_init();
+
 	// superblock defined at block address 1
-	disk_rd( 1, (uint8_t*)(&fs), sizeof( fs_t ) ); // TODO: investigate padding
+	bcache_rd( 1, (uint8_t*)(&fs), sizeof( fs_t ) ); // TODO: investigate padding
+  fs_dirty = 0;
+
+  // free-space bitmap, if formatted with one, is held in memory
+  if (fs.fs_alloc != FS_LIST)
+    bcache_rd( fs.fs_bmblkno, fs_bmap, BMAP_LIMIT );
+
+  // as are block reference counts (none if formatted before reflink)
+  memset( fs_rcnt, 0, RCNT_LIMIT );
+  fs_rcdirty = 0;
+  if (fs.fs_rcblkno != 0 && fs.fs_rcblkno < fs.fs_size && fs.fs_size <= RCNT_LIMIT) {
+    for (daddr32_t a = fs.fs_rcblkno; a < fs.fs_size; a++)
+      bcache_rd( a, fs_rcnt + (a - fs.fs_rcblkno) * BLOCK_SIZE, BLOCK_SIZE );
+  }
+
+  // not unmounted cleanly: the free list on disk can't be trusted
+  if (fs.fs_sblkno == 1 && !fs.fs_clean)
+    recover();
 
   // set up default working directory
   cwd       = ROOT_DIR;
 
   UART0->IMSC           |= 0x00000010; // enable UART    (Rx) interrupt
   UART0->CR              = 0x00000301; // enable UART (Tx+Rx)
+  UART1->IMSC           |= 0x00000050; // enable disk UART (Rx+Rx timeout) interrupt
 
   TIMER0->Timer1Load     = 0x00001000; // select period = 2^20 ticks ~= 1 sec
   TIMER0->Timer1Ctrl     = 0x00000002; // select 32-bit   timer
@@ -1140,6 +3752,7 @@ void kernel_handler_rst( ctx_t* ctx ) {
   GICC0->PMR             = 0x000000F0; // unmask all            interrupts
   GICD0->ISENABLER[ 1 ] |= 0x00000010; // enable timer          interrupt
   GICD0->ISENABLER[ 1 ] |= 0x00001000; // enable UART    (Rx) interrupt
+  GICD0->ISENABLER[ 1 ] |= 0x00002000; // enable disk UART (Rx) interrupt
   GICC0->CTLR            = 0x00000001; // enable GIC interface
   GICD0->CTLR            = 0x00000001; // enable GIC distributor
 
@@ -1153,6 +3766,10 @@ void kernel_handler_irq( ctx_t* ctx ) {
 
   // handle the interrupt, then clear (or reset) the source.
   if( id == GIC_SOURCE_TIMER0 ) {
+    // periodic write back, so a crash loses little more than SYNC_PERIOD ticks of changes
+    if (++ticks % SYNC_PERIOD == 0)
+      sync_due = 1;
+
     scheduler( ctx );
     TIMER0->Timer1IntClr = 0x01;
   }
@@ -1164,6 +3781,10 @@ void kernel_handler_irq( ctx_t* ctx ) {
     }
     UART0->ICR = 0x10;
   }
+  else if( id == GIC_SOURCE_UART1 ) {
+    disk_irq(); // may complete a read, waking whoever waits on it
+    UART1->ICR = 0x50;
+  }
 
   GICC0->EOIR = id; // write the interrupt identifier to signal we're done
 
@@ -1171,6 +3792,25 @@ void kernel_handler_irq( ctx_t* ctx ) {
 }
 
 void kernel_handler_svc( ctx_t* ctx, uint32_t id ) { 
+  // write back noted as due by the timer interrupt
+  if (sync_due) {
+    sync_due = 0;
+    isync();
+    sbflush();
+    bsync();
+  }
+
+  const int restartable = io_restartable( ctx, id );
+
+  io_async = restartable && io_ready();
+  if (io_async) {
+    if (setjmp( io_jmp ) != 0) { // syscall is waiting on the disk
+      io_async = 0;
+      io_block( ctx );
+      return;
+    }
+  }
+
   switch( id ) {
     case 0x00 : { // yield()
       scheduler( ctx );
@@ -1253,7 +3893,7 @@ void kernel_handler_svc( ctx_t* ctx, uint32_t id ) {
       break;
     }
     case 0x0b : { // reformat
-      wipe();
+      wipe( ctx->gpr[ 0 ] <= FS_BESTFIT ? ctx->gpr[ 0 ] : FS_LIST );
       break;
     }
     case 0x0c : { // open file
@@ -1269,34 +3909,6 @@ void kernel_handler_svc( ctx_t* ctx, uint32_t id ) {
       PL011_putc( UART0, '/' );
       break;
     }
-    case 0x0f : { // ls
-      inode_t inode;
-      readInode( &inode, cwd );
-      
-      const int dirs = inode.i_ic.ic_size / 32;
-      const int blks = ((dirs-1) / 16) + 1;	// number of blocks
-	    const int r		 = dirs % 16;			      // offset in last block
-	
-	    dir_t dir[ 16 ];
-
-	    for (int i = 0; i < blks-1; i++) {
-		    disk_rd( inode.i_ic.ic_db[ i ], (uint8_t*)dir, 16 * sizeof( dir_t ) );
-		    for (int j = 0; j < 16; j++) {
-			    for( int k = 0; k < dir[ j ].d_namlen; k++ )
-            PL011_putc( UART0, dir[ j ].d_name[ k ] );
-          PL011_putc( UART0, '\n' );
-		    }
-	    }
-
-	    disk_rd( inode.i_ic.ic_db[ blks-1 ], (uint8_t*)dir, 16 * sizeof( dir_t ) );
-	    for (int j = 0; j < r; j++) {
-		    for( int k = 0; k < dir[ j ].d_namlen; k++ )
-          PL011_putc( UART0, dir[ j ].d_name[ k ] );
-        PL011_putc( UART0, '\n' );
-	    }
-
-      break;
-    }
     case 0x10 : { // mkdir
       inode_t child;
       if ( getFreeInode( &child ) == NULL ) {
@@ -1313,9 +3925,15 @@ void kernel_handler_svc( ctx_t* ctx, uint32_t id ) {
 
       child.i_ic.ic_mode = IFDIR;
       child.i_ic.ic_size = 64;
-      child.i_ic.ic_db[ 0 ] = balloc(); // note: this updates the disk
+
+      const int addr = allocateDataBlockAddr( &child, 0 );
+      if (addr == -1) {
+        ctx->gpr[ 0 ] = -1; // failed
+        break;
+      }
 
       dir_t dir[ 16 ];
+      memset( dir, 0, sizeof( dir ) );
 
       dir[ 0 ].d_ino = child.i_number;
       dir[ 0 ].d_namlen = 1;
@@ -1325,7 +3943,7 @@ void kernel_handler_svc( ctx_t* ctx, uint32_t id ) {
       dir[ 1 ].d_namlen = 2;
       dir[ 1 ].d_name[ 0 ] = '.'; dir[ 1 ].d_name[ 1 ] = '.';
 
-      disk_wr( child.i_ic.ic_db[ 0 ], (uint8_t *)dir, BLOCK_SIZE );
+      bcache_wr( addr, (uint8_t *)dir, BLOCK_SIZE );
       writeInode( &child );
       addInodeToDirectory( &parent, child.i_number, (char *)ctx->gpr[ 0 ] );  
 
@@ -1334,17 +3952,7 @@ void kernel_handler_svc( ctx_t* ctx, uint32_t id ) {
       break;
     }
     case 0x11 : { // cd
-      inode_t  inode;
-	    int 		 ino = cwd;
-	    char 	  *tok;
-
-      for (tok = strtok( (char*)ctx->gpr[ 0 ], "/" ); 
-			     tok != NULL && ino != -1; 
-			     tok = strtok( NULL, "/" ) ) 
-      {
-		    readInode( &inode, ino );
-		    ino  = name_to_ino( tok, &inode );
-	    }
+      int ino = path_to_ino( (char*)ctx->gpr[ 0 ], cwd );
 
       if (ino == -1) {
         ctx->gpr[ 0 ] = -1; // failure
@@ -1378,43 +3986,97 @@ void kernel_handler_svc( ctx_t* ctx, uint32_t id ) {
       if (remove( &dir, &inode, (char*)ctx->gpr[ 0 ] ) != -1) { 
         addInodeToDirectory( &dest, dir.d_ino, dir.d_name );        
       }
-
-      disk_wr( fs.fs_sblkno, (uint8_t*)(&fs), sizeof( fs_t ) ); // update sb
   
       break;
     }
-    case 0x14 : { // cp
-      if ( ((char*)ctx->gpr[ 0 ])[0] == '.' ) {
-        ctx->gpr[ 0 ] = -1;
-        break;
-      }
-
-      int ino = path_to_ino( (char*)ctx->gpr[ 0 ], cwd ); 
-      if (ino == -1) break;
-      
-      inode_t src; readInode( &src, ino );  
-      if (src.i_ic.ic_mode == IFZERO) break; 
-
-      inode_t dest;
-      copyInode( &dest, &src );
-
-      addInodeToDirectory( readInode( &src, cwd ), dest.i_number, (char*)ctx->gpr[ 1 ] );        
-
-      disk_wr( fs.fs_sblkno, (uint8_t*)(&fs), sizeof( fs_t ) ); // update sb
-
-      break;
-    }
     case 0x15 : { // tell
       ctx->gpr[ 0 ] = tell( ctx->gpr[ 0 ] );
       break;
     }
     case 0x16 : {
       ctx->gpr[ 0 ] = mq_unlink( ctx->gpr[ 0 ] );
+      break;
+    }
+    case 0x17 : { // sync
+      isync();
+      sbflush();
+      ctx->gpr[ 0 ] = bsync();
+      break;
+    }
+    case 0x18 : { // iostat
+      io_stats.io_trips = disk_get_trips();
+      io_stats.tm_clock = ticks * TIMER0->Timer1Load + (TIMER0->Timer1Load - TIMER0->Timer1Value);
+      memcpy( (iostat_t*)ctx->gpr[ 0 ], &io_stats, sizeof( iostat_t ) );
+      ctx->gpr[ 0 ] = 0;
+      break;
+    }
+    case 0x19 : { // umount
+      ctx->gpr[ 0 ] = unmount();
+      break;
+    }
+    case 0x1a : { // stat
+      ctx->gpr[ 0 ] = stat( (char*)ctx->gpr[ 0 ], (stat_t*)ctx->gpr[ 1 ] );
+      break;
+    }
+    case 0x1b : { // ftruncate
+      ctx->gpr[ 0 ] = truncate( ctx->gpr[ 0 ], ctx->gpr[ 1 ] );
+      break;
+    }
+    case 0x1c : { // getdents
+      ctx->gpr[ 0 ] = getdents( (char*)ctx->gpr[ 0 ], (uint32_t*)ctx->gpr[ 1 ], (dirent_t*)ctx->gpr[ 2 ], ctx->gpr[ 3 ] );
+      break;
+    }
+    case 0x1d : { // sendfile
+      ctx->gpr[ 0 ] = sendfile( ctx->gpr[ 0 ], ctx->gpr[ 1 ], (uint32_t*)ctx->gpr[ 2 ], ctx->gpr[ 3 ] );
+      break;
+    }
+    case 0x1e : { // pread( fd, x, n, offset )
+      ctx->gpr[ 0 ] = fpread( ctx->gpr[ 0 ], (uint8_t*)ctx->gpr[ 1 ], ctx->gpr[ 2 ], ctx->gpr[ 3 ] );
+      break;
+    }
+    case 0x1f : { // pwrite( fd, x, n, offset )
+      ctx->gpr[ 0 ] = fpwrite( ctx->gpr[ 0 ], (uint8_t*)ctx->gpr[ 1 ], ctx->gpr[ 2 ], ctx->gpr[ 3 ] );
+      break;
+    }
+    case 0x20 : { // readv( fd, iov, cnt )
+      ctx->gpr[ 0 ] = freadv( ctx->gpr[ 0 ], (iovec_t*)ctx->gpr[ 1 ], ctx->gpr[ 2 ] );
+      break;
+    }
+    case 0x21 : { // writev( fd, iov, cnt )
+      ctx->gpr[ 0 ] = fwritev( ctx->gpr[ 0 ], (iovec_t*)ctx->gpr[ 1 ], ctx->gpr[ 2 ] );
+      break;
+    }
+    case 0x22 : { // reflink( out, in )
+      ctx->gpr[ 0 ] = reflink( ctx->gpr[ 0 ], ctx->gpr[ 1 ] );
+      break;
+    }
+    case 0x23 : { // aio_read( cb )
+      ctx->gpr[ 0 ] = aio_submit( AIO_READ, (aiocb_t*)ctx->gpr[ 0 ] );
+      break;
+    }
+    case 0x24 : { // aio_write( cb )
+      ctx->gpr[ 0 ] = aio_submit( AIO_WRITE, (aiocb_t*)ctx->gpr[ 0 ] );
+      break;
+    }
+    case 0x25 : { // aio_fsync( cb )
+      ctx->gpr[ 0 ] = aio_submit( AIO_FSYNC, (aiocb_t*)ctx->gpr[ 0 ] );
+      break;
     }
     default: {
       break;
     }
   }
 
+  if (restartable) {
+    io_async = 0;
+    current->io_wait = 0; // completed
+  }
+
+  // asynchronous requests whose reads have completed since
+  if (aio_due) {
+    aio_due = 0;
+    aioService( 0 );
+  }
+
   return;
 }
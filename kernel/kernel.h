@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <setjmp.h>
 
 // hardware
 #include   "GIC.h"
@@ -17,6 +18,9 @@
 #include "terms.h"
 #include "mqueue.h"
 #include "fs.h"
+#include "bcache.h"
+#include "icache.h"
+#include "dcache.h"
 
 // static user progs
 #include "init.h"
@@ -28,6 +32,9 @@
 #include "pong.h"
 #include "blanks.h"
 #include "hashs.h"
+#include "fsbench.h"
+#include "dirbench.h"
+#include "iobench.h"
 
 #define PROCESS_LIMIT 8 // limit on number of processes running at once
 
@@ -59,6 +66,10 @@ typedef struct {
 
   // file descriptor table (holds file descriptions)
   ofile_t *fd[ FDT_LIMIT ];
+
+  // disk I/O
+  uint32_t io_wait;  // times the current syscall has waited on the disk
+  uint32_t io_block; // waiting on the disk (woken by the read completing)
 } pcb_t;
 
 // === PROCESS + SIGNAL FUNCTIONS ===
@@ -74,4 +85,10 @@ void rq_add( pid_t pid );
 void rq_rm( pid_t pid );
 void scheduler( ctx_t* ctx );
 
+// === DISK I/O FUNCTIONS ===
+int io_restartable( ctx_t* ctx, uint32_t id );
+int io_ready();
+void io_block( ctx_t* ctx );
+void iowait();
+
 #endif
@@ -2,6 +2,7 @@
 #define __MQUEUE_H
 
 #define MSGCHAN_LIMIT 32 // limit on number of message queues open at once
+#define MQ_AIO_LIMIT   8 // limit on number of completions (see aio) held by a message queue
 
 typedef int mqd_t; // message queue descriptor (index for kernel)
 
@@ -15,6 +16,9 @@ typedef struct mqueue {
   int msg_lrpid;  // last receive process id
 
   uint8_t msg_qbuf[64]; // queue data 64 byte limit
+
+  aiocomp_t msg_qaio[ MQ_AIO_LIMIT ]; // completions posted by the kernel, oldest first
+  int       msg_qnaio;                // number of completions queued
 } mqueue;
 
 mqd_t mq_open(int name); // channel established using magic number
@@ -22,5 +26,6 @@ int mq_close(mqd_t mqd);
 int mq_unlink(int name);
 int mq_receive(mqd_t mqd, uint8_t *msg_ptr, size_t msg_len);
 int mq_send(mqd_t mqd, uint8_t *msg_ptr, size_t msg_len);
+int mq_post(mqd_t mqd, const aiocomp_t *c); // queue a completion (no sender to wait on)
 
 #endif
@@ -21,4 +21,65 @@ typedef enum {
   O_EXIST
 } oflag_t; 
 
+typedef enum {
+  FS_LIST,    // free list chained through data blocks
+  FS_NEXTFIT, // free-space bitmap, allocating next-fit
+  FS_BESTFIT  // free-space bitmap, allocating best-fit
+} falloc_t; // free-space layout (see wipe)
+
+typedef struct {
+  uint32_t bc_hits;       // block reads served by the buffer cache
+  uint32_t bc_misses;     // block reads that went to the disk
+  uint32_t bc_writebacks; // dirty blocks written back to the disk
+  uint32_t io_trips;      // requests sent to the disk (round trips)
+  uint32_t ra_hits;       // read-ahead blocks later read
+  uint32_t ra_wasted;     // read-ahead blocks evicted unread
+  uint32_t al_blocks;     // data blocks allocated
+  uint32_t al_probes;     // free list entries / bitmap positions examined to allocate them
+  uint32_t al_refills;    // free list blocks read to refill the superblock's list
+  uint32_t dc_hits;       // path components found in the dentry cache
+  uint32_t dc_misses;     // path components looked up in their directory
+  uint32_t tm_clock;      // timer counts so far (1 MHz), to time things by
+  uint32_t io_copied;     // blocks copied by the disk itself, so never sent over the wire
+} iostat_t; // kernel I/O counters
+
+typedef struct {
+  uint32_t st_ino;        // inode number
+  uint32_t st_mode;       // inode type
+  uint32_t st_size;       // size in bytes (holes included)
+  uint32_t st_blocks;     // data blocks allocated (holes have none)
+  uint32_t st_runs;       // runs of consecutive data blocks they form (1 if unfragmented)
+} stat_t; // file status
+
+typedef struct {
+  uint32_t iov_off;       // file offset
+  void    *iov_base;      // buffer
+  uint32_t iov_len;       // number of bytes
+} iovec_t; // I/O segment, as read or written by readv / writev
+
+typedef struct {
+  int      aio_fd;        // file descriptor
+  uint32_t aio_offset;    // file offset
+  void    *aio_buf;       // buffer
+  uint32_t aio_nbytes;    // number of bytes
+  int      aio_mqd;       // message queue the completion is posted to (see mqinit)
+  uint32_t aio_tag;       // caller's tag, handed back in the completion
+} aiocb_t; // asynchronous I/O request, as queued by aio_read / aio_write / aio_fsync
+
+typedef struct {
+  uint32_t ac_tag;        // aio_tag of the request
+  int32_t  ac_result;     // bytes read / written (0 for fsync), -1 if it failed
+} aiocomp_t; // completion of an asynchronous I/O request, as received from its message queue
+
+#define DT_DIR ( 2 ) // d_mode of a directory    (IFDIR)
+#define DT_REG ( 3 ) // d_mode of a regular file (IFREG)
+
+typedef struct {
+  uint32_t d_ino;         // inode number
+  uint32_t d_size;        // size in bytes
+  uint16_t d_mode;        // inode type (DT_DIR, DT_REG)
+  uint16_t d_namlen;      // length of the name
+  char     d_name[ 28 ];  // null terminated name (at most MAXNAMLEN characters)
+} dirent_t; // directory entry, as listed by getdents
+
 #endif
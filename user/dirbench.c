@@ -0,0 +1,85 @@
+#include "dirbench.h"
+
+/* Measures name lookups in a growing directory, so it destroys whatever
+ * is on the disk: it formats the disk, then fills one directory with
+ * files (every eighth a directory instead). Each time the directory has
+ * doubled, it stats the names it created last (which the dentry cache
+ * doesn't hold yet) and one it never did, reporting the blocks read per
+ * lookup (via the buffer cache, so hits count too). Scanning for those
+ * reads most of the directory, whereas once it is indexed a lookup reads
+ * the "." block, an index block and the block holding the entry.
+ */
+
+#define DIRBENCH_ENTRIES 448 // entries created (bounded by the 512 inodes a disk has)
+#define DIRBENCH_SAMPLE  32  // (at most) names looked up each time
+
+// path of entry i, from the root (as fopen takes it); its name in the directory is path + 5
+void dirbench_name( char *path, int i ) {
+  memcpy( path, "dirb/e", 6 );
+  int2str( i, path + 6, 10 );
+}
+
+void dirbench_lookup( int n ) {
+  char path[ 16 ], buf[ 12 ];
+  iostat_t s0, s1;
+  stat_t   st;
+  int      found = 0;
+
+  // the names created last, which no lookup has cached yet
+  const int k = n < DIRBENCH_SAMPLE ? n : DIRBENCH_SAMPLE;
+
+  iostat( &s0 );
+  for (int i = n - k; i < n; i++) {
+    dirbench_name( path, i );
+    if (fstat( path + 5, &st ) != -1)
+      found++;
+  }
+  iostat( &s1 );
+
+  const int hit = (s1.bc_hits + s1.bc_misses) - (s0.bc_hits + s0.bc_misses);
+
+  dirbench_name( path, DIRBENCH_ENTRIES + n ); // never created
+
+  iostat( &s0 );
+  fstat( path + 5, &st );
+  iostat( &s1 );
+
+  const int miss = (s1.bc_hits + s1.bc_misses) - (s0.bc_hits + s0.bc_misses);
+
+  write( STDIO, "entries ", 8 );             write_int( STDIO, buf, n );
+  write( STDIO, ": found ", 8 );             write_int( STDIO, buf, found );
+  write( STDIO, ", blocks read per lookup ", 25 );
+  write_int( STDIO, buf, hit / k ); write( STDIO, ".", 1 );
+  write_int( STDIO, buf, (hit * 10 / k) % 10 );
+  write( STDIO, ", for a missing name ", 21 ); write_int( STDIO, buf, miss );
+  write( STDIO, "\n", 1 );
+}
+
+void dirbench() {
+  char path[ 16 ];
+
+  disk_wipe( FS_NEXTFIT );
+  mkdir( "dirb" );
+  cd( "dirb" );
+
+  for (int i = 0, n = 8; i < DIRBENCH_ENTRIES; i++) {
+    dirbench_name( path, i );
+
+    if (i % 8 == 7)
+      mkdir( path + 5 );
+    else
+      fclose( fopen( path, O_CREAT ) );
+
+    if (i + 1 == n || i + 1 == DIRBENCH_ENTRIES) {
+      dirbench_lookup( i + 1 );
+      n *= 2;
+    }
+  }
+
+  cd( ".." );
+
+  cexit();
+}
+
+// TODO: remove when able to dynamically load programs
+void (*entry_dirbench)() = &dirbench;
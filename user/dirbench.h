@@ -0,0 +1,14 @@
+#ifndef __DIRBENCH_H
+#define __DIRBENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "libc.h"
+
+// TODO: remove when able to dynamically load programs
+extern void (*entry_dirbench)();
+
+#endif
@@ -0,0 +1,81 @@
+#include "fsbench.h"
+
+/* Compares the free-space layouts wipe can format the disk in, so it
+ * destroys whatever is on the disk: for each layout in turn it formats
+ * the disk, writes files of mixed sizes, deletes every other one (which
+ * leaves the free space fragmented), then writes some more. For those
+ * later files it reports the runs of consecutive blocks they ended up
+ * in (one per file is ideal), then what allocating every block cost.
+ */
+
+#define FSBENCH_FILES 12 // files written before the deletes (then half as many after)
+
+uint8_t fsbench_data[ 8192 ];
+
+void fsbench_run( falloc_t alloc, char *name ) {
+  char path[ 8 ] = "fsb/f0", buf[ 12 ];
+  iostat_t s0, s1;
+  stat_t   st;
+  int      fd, runs = 0, blocks = 0;
+
+  disk_wipe( alloc );
+  mkdir( "fsb" );
+  iostat( &s0 );
+
+  // files of 2, 4, 6 and 8 KB
+  for (int i = 0; i < FSBENCH_FILES; i++) {
+    path[ 5 ] = 'a' + i;
+    fd = fopen( path, O_CREAT );
+    write( fd, fsbench_data, (i % 4 + 1) * 2048 );
+    fclose( fd );
+  }
+
+  // every other one deleted
+  cd( "fsb" );
+  for (int i = 1; i < FSBENCH_FILES; i += 2) {
+    path[ 5 ] = 'a' + i;
+    funlink( path + 4 );
+  }
+  cd( ".." );
+
+  // files of 12 KB (written 4 KB at a time), the last of 32 KB
+  for (int i = 0; i < FSBENCH_FILES / 2; i++) {
+    path[ 5 ] = 'A' + i;
+    fd = fopen( path, O_CREAT );
+    for (int j = 0; j < (i == FSBENCH_FILES / 2 - 1 ? 8 : 3); j++)
+      write( fd, fsbench_data, 4096 );
+    fclose( fd );
+  }
+
+  iostat( &s1 );
+
+  cd( "fsb" );
+  for (int i = 0; i < FSBENCH_FILES / 2; i++) {
+    path[ 5 ] = 'A' + i;
+    if (fstat( path + 4, &st ) != -1) {
+      runs   += st.st_runs;
+      blocks += st.st_blocks;
+    }
+  }
+  cd( ".." );
+
+  write( STDIO, name, strlen( name ) );
+  write( STDIO, ": runs ", 7 );              write_int( STDIO, buf, runs );
+  write( STDIO, " for ", 5 );                write_int( STDIO, buf, blocks );
+  write( STDIO, " blocks; allocated ", 19 ); write_int( STDIO, buf, s1.al_blocks - s0.al_blocks );
+  write( STDIO, " blocks, probes ", 16 );    write_int( STDIO, buf, s1.al_probes - s0.al_probes );
+  write( STDIO, ", list refills ", 15 );     write_int( STDIO, buf, s1.al_refills - s0.al_refills );
+  write( STDIO, ", disk requests ", 16 );    write_int( STDIO, buf, s1.io_trips - s0.io_trips );
+  write( STDIO, "\n", 1 );
+}
+
+void fsbench() {
+  fsbench_run( FS_LIST,    "list"     );
+  fsbench_run( FS_NEXTFIT, "next-fit" );
+  fsbench_run( FS_BESTFIT, "best-fit" );
+
+  cexit();
+}
+
+// TODO: remove when able to dynamically load programs
+void (*entry_fsbench)() = &fsbench;
@@ -1,19 +1,32 @@
 #include "hashs.h"
 
+#define HASHS_RECORDS 128 // "####" records written to the grid
+
 void hashs() {
+  iovec_t  iov[ HASHS_RECORDS ];
+  uint32_t off = 0;
+  int      n   = 0;
+
+  // lay the records out as writing each, then seeking past the gap to the next, would
+  for (int i = 0; i < 8; i++) {
+    for (int j = 0; j < 4; j++) {
+      for (int k = 0; k < 4; k++) {
+        iov[ n ].iov_off  = off;
+        iov[ n ].iov_base = "####";
+        iov[ n ].iov_len  = 4;
+
+        off += k < 3 ? 8 : 9;
+        n++;
+      }
+    }
+    if (i % 2 == 0) off += 4;
+    else            off -= 4;
+  }
+
   int FILE = fopen( "grid", O_CREAT );
   
   if (FILE != -1 ) {
-    for (int i = 0; i < 8; i++) {
-      for (int j = 0; j < 4; j++) {
-        write( FILE, "####", 4 ); fseek( FILE, 4, SEEK_CUR );
-        write( FILE, "####", 4 ); fseek( FILE, 4, SEEK_CUR );
-        write( FILE, "####", 4 ); fseek( FILE, 4, SEEK_CUR );
-        write( FILE, "####", 4 ); fseek( FILE, 5, SEEK_CUR );
-      }
-      if (i % 2 == 0) fseek( FILE,  4, SEEK_CUR );
-      else            fseek( FILE, -4, SEEK_CUR );
-    }
+    writev( FILE, iov, n );
   }
 
   fclose( FILE );
@@ -24,16 +24,53 @@ void init() {
       ckill( str2int( strtok(NULL, " \n\r"), 1, 10 ), SIGKILL );
     }
     else if (strncmp(tok, "wipe", 4) == 0) {
-      disk_wipe();
+      tok = strtok( NULL, " \n\r" );
+
+      if      (tok != NULL && strncmp(tok, "next", 4) == 0) disk_wipe( FS_NEXTFIT );
+      else if (tok != NULL && strncmp(tok, "best", 4) == 0) disk_wipe( FS_BESTFIT );
+      else                                                  disk_wipe( FS_LIST );
     }
     else if (strncmp(tok, "quit", 4) == 0) {
+      umount();
       break;
     }
+    else if (strncmp(tok, "sync", 4) == 0) {
+      sync();
+    }
+    else if (strncmp(tok, "iostat", 6) == 0) {
+      iostat_t s; char buf[ 12 ];
+      iostat( &s );
+
+      write( STDIO, "cache hits ", 11 );       write_int( STDIO, buf, s.bc_hits );
+      write( STDIO, ", misses ", 9 );          write_int( STDIO, buf, s.bc_misses );
+      write( STDIO, ", writebacks ", 13 );     write_int( STDIO, buf, s.bc_writebacks );
+      write( STDIO, "\ndisk requests ", 15 );  write_int( STDIO, buf, s.io_trips );
+      write( STDIO, ", blocks copied ", 16 );  write_int( STDIO, buf, s.io_copied );
+      write( STDIO, "\nread-ahead hits ", 17 ); write_int( STDIO, buf, s.ra_hits );
+      write( STDIO, ", wasted ", 9 );          write_int( STDIO, buf, s.ra_wasted );
+      write( STDIO, "\nblocks allocated ", 18 ); write_int( STDIO, buf, s.al_blocks );
+      write( STDIO, ", probes ", 9 );          write_int( STDIO, buf, s.al_probes );
+      write( STDIO, ", list refills ", 15 );   write_int( STDIO, buf, s.al_refills );
+      write( STDIO, "\nname cache hits ", 17 ); write_int( STDIO, buf, s.dc_hits );
+      write( STDIO, ", misses ", 9 );          write_int( STDIO, buf, s.dc_misses );
+      write( STDIO, "\n", 1 );
+    }
+    else if (strncmp(tok, "stats", 5) == 0) {
+      stat_t s; char buf[ 12 ];
+
+      if (fstat( strtok( NULL, " \n\r" ), &s ) != -1) {
+        write( STDIO, "size ", 5 );       write_int( STDIO, buf, s.st_size );
+        write( STDIO, ", blocks allocated ", 19 ); write_int( STDIO, buf, s.st_blocks );
+        write( STDIO, ", runs ", 7 );     write_int( STDIO, buf, s.st_runs );
+        write( STDIO, "\n", 1 );
+      }
+    }
     else if (strncmp(tok, "pwd", 3) == 0) {
       pwd();
     }
     else if (strncmp(tok, "ls", 2) == 0) {
-      ls();
+      tok = strtok( NULL, " \n\r" );
+      ls( tok != NULL ? tok : "." );
     }
     else if (strncmp(tok, "mkdir", 5) == 0) {
       mkdir( strtok( NULL, " \n\r" ) );
@@ -48,23 +85,17 @@ void init() {
       mv( strtok( NULL, " \n\r" ), strtok( NULL, " \n\r" ) );
     }
     else if (strncmp(tok, "cp", 2) == 0) {
-      cp( strtok( NULL, " \n\r" ), strtok( NULL, " \n\r" ) );
+      char *src = strtok( NULL, " \n\r" );
+      int reflink = src != NULL && strncmp( src, "--reflink", 10 ) == 0;
+      if (reflink)
+        src = strtok( NULL, " \n\r" );
+
+      cp( src, strtok( NULL, " \n\r" ), reflink );
     }
     else if (strncmp(tok, "cat", 3) == 0) {
-      tok = strtok( NULL, " \n\r" );
-      int FILE = fopen( tok, O_EXIST );
+      int FILE = fopen( strtok( NULL, " \n\r" ), O_EXIST );
       if (FILE != -1) {
-        fseek( FILE, 0, SEEK_END );
-        int length = ftell( FILE );
-        fseek( FILE, 0, SEEK_SET );
-
-        char buf[ 512 ]; int n;
-        for (int i = 0; i < length; i+=512) {
-          n = length - i > 512 ? 512 : length - i;
-          read( FILE, &buf, n );
-          write( STDIO, &buf, n );
-        }
-
+        fsendfile( STDIO, FILE, NULL, SEND_ALL );
         fclose( FILE );
       } 
     }
@@ -0,0 +1,115 @@
+#include "iobench.h"
+
+/* Measures throughput through an open file for calls of 1, 4, 512 and
+ * 65536 bytes: for each size it writes a 64 KB file in calls of that
+ * size, then reads it back the same way, reporting the time each took
+ * (in timer counts, from iostat), the rate that works out at and the
+ * blocks read via the buffer cache. The file stays cached throughout,
+ * so the gap between sizes is the cost per call, rather than the disk.
+ * Last, it's read back by asynchronous reads of IOBENCH_AIO bytes, with
+ * IOBENCH_DEPTH queued at any time, collecting the completions of all
+ * those done by each msgreceive.
+ */
+
+#define IOBENCH_SIZE  65536 // bytes written, then read, per call size
+#define IOBENCH_AIO   4096  // bytes per asynchronous read
+#define IOBENCH_DEPTH 4     // asynchronous reads queued at once
+#define IOBENCH_MQ    200   // name of the message queue their completions are posted to
+
+uint8_t iobench_data[ IOBENCH_SIZE ];
+
+void iobench_report( char *what, int size, iostat_t *s0, iostat_t *s1 ) {
+  char buf[ 12 ];
+
+  const uint32_t t = s1->tm_clock - s0->tm_clock;
+
+  write( STDIO, what, strlen( what ) ); write_int( STDIO, buf, size );
+  write( STDIO, " bytes a call: ", 15 );    write_int( STDIO, buf, t );
+  write( STDIO, " counts, ", 9 );           write_int( STDIO, buf, t > 0 ? (IOBENCH_SIZE / 1024) * 1000000 / t : 0 );
+  write( STDIO, " KB/s, blocks read ", 19 ); write_int( STDIO, buf, (s1->bc_hits + s1->bc_misses) - (s0->bc_hits + s0->bc_misses) );
+  write( STDIO, ", disk requests ", 16 );   write_int( STDIO, buf, s1->io_trips - s0->io_trips );
+  write( STDIO, "\n", 1 );
+}
+
+void iobench_run( int size ) {
+  iostat_t s0, s1;
+  int      fd;
+
+  fd = fopen( "iob", O_CREAT );
+  iostat( &s0 );
+  for (int i = 0; i < IOBENCH_SIZE; i += size)
+    write( fd, iobench_data + i, size );
+  iostat( &s1 );
+  fclose( fd );
+
+  iobench_report( "write ", size, &s0, &s1 );
+
+  fd = fopen( "iob", O_EXIST );
+  iostat( &s0 );
+  for (int i = 0; i < IOBENCH_SIZE; i += size)
+    read( fd, iobench_data + i, size );
+  iostat( &s1 );
+  fclose( fd );
+
+  iobench_report( "read  ", size, &s0, &s1 );
+
+  funlink( "iob" );
+}
+
+void iobench_aio() {
+  iostat_t  s0, s1;
+  aiocb_t   cb;
+  aiocomp_t c[ IOBENCH_DEPTH ];
+  int       fd, mqd, queued = 0, done = 0, failed = 0;
+
+  fd = fopen( "iob", O_CREAT );
+  write( fd, iobench_data, IOBENCH_SIZE );
+  fclose( fd );
+
+  fd  = fopen( "iob", O_EXIST );
+  mqd = mqinit( IOBENCH_MQ );
+  iostat( &s0 );
+  while (done < IOBENCH_SIZE / IOBENCH_AIO) {
+    for (; queued < IOBENCH_SIZE / IOBENCH_AIO && queued - done < IOBENCH_DEPTH; queued++) {
+      cb.aio_fd     = fd;
+      cb.aio_offset = queued * IOBENCH_AIO;
+      cb.aio_buf    = iobench_data + queued * IOBENCH_AIO;
+      cb.aio_nbytes = IOBENCH_AIO;
+      cb.aio_mqd    = mqd;
+      cb.aio_tag    = queued;
+
+      if (aio_read( &cb ) == -1)
+        break; // queue full: collect some first
+    }
+
+    const int n = msgreceive( mqd, c, sizeof( c ) ) / sizeof( aiocomp_t );
+    for (int i = 0; i < n; i++)
+      failed += c[ i ].ac_result != IOBENCH_AIO;
+    done += n;
+  }
+  iostat( &s1 );
+  mqunlink( mqd );
+  fclose( fd );
+
+  iobench_report( "aio   ", IOBENCH_AIO, &s0, &s1 );
+  if (failed > 0)
+    write( STDIO, "aio reads failed\n", 17 );
+
+  funlink( "iob" );
+}
+
+void iobench() {
+  for (int i = 0; i < IOBENCH_SIZE; i++)
+    iobench_data[ i ] = i;
+
+  iobench_run( 1 );
+  iobench_run( 4 );
+  iobench_run( 512 );
+  iobench_run( IOBENCH_SIZE );
+  iobench_aio();
+
+  cexit();
+}
+
+// TODO: remove when able to dynamically load programs
+void (*entry_iobench)() = &iobench;
@@ -94,7 +94,7 @@ void msgsend( int mqd, const void* buf, size_t size ) {
   return;
 }
 
-void msgreceive( int mqd, const void* buf, size_t size ) {
+int msgreceive( int mqd, const void* buf, size_t size ) {
   int m;
 
   asm volatile( "mov r0, %1 \n"
@@ -108,10 +108,10 @@ void msgreceive( int mqd, const void* buf, size_t size ) {
 
   // If fails, try again later
   if (m == -1) {
-    msgreceive( mqd, buf, size );
+    return msgreceive( mqd, buf, size );
   }
 
-  return;
+  return m;
 }
 
 
@@ -145,8 +145,113 @@ int read( int fd, void* x, size_t n ) {
   return r;
 }
 
-void disk_wipe() {
-  asm volatile( "svc #11 \n" );
+int pread( int fd, void* x, size_t n, uint32_t offset ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "mov r1, %2 \n"
+                "mov r2, %3 \n"
+                "mov r3, %4 \n"
+                "svc #30    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (fd), "r" (x), "r" (n), "r" (offset) 
+              : "r0", "r1", "r2", "r3" );
+
+  return r;
+}
+
+int pwrite( int fd, void* x, size_t n, uint32_t offset ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "mov r1, %2 \n"
+                "mov r2, %3 \n"
+                "mov r3, %4 \n"
+                "svc #31    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (fd), "r" (x), "r" (n), "r" (offset) 
+              : "r0", "r1", "r2", "r3" );
+
+  return r;
+}
+
+int readv( int fd, const iovec_t* iov, int cnt ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "mov r1, %2 \n"
+                "mov r2, %3 \n"
+                "svc #32    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (fd), "r" (iov), "r" (cnt) 
+              : "r0", "r1", "r2" );
+
+  return r;
+}
+
+int writev( int fd, const iovec_t* iov, int cnt ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "mov r1, %2 \n"
+                "mov r2, %3 \n"
+                "svc #33    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (fd), "r" (iov), "r" (cnt) 
+              : "r0", "r1", "r2" );
+
+  return r;
+}
+
+int aio_read( const aiocb_t* cb ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "svc #35    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (cb) 
+              : "r0"      );
+
+  return r;
+}
+
+int aio_write( const aiocb_t* cb ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "svc #36    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (cb) 
+              : "r0"      );
+
+  return r;
+}
+
+int aio_fsync( const aiocb_t* cb ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "svc #37    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (cb) 
+              : "r0"      );
+
+  return r;
+}
+
+void disk_wipe( falloc_t alloc ) {
+  asm volatile( "mov r0, %0 \n"
+                "svc #11    \n"
+              :
+              : "r" (alloc)
+              : "r0"            );
 }
 
 int fopen( const char *path, int ofile ) {
@@ -217,6 +322,101 @@ int ftell( const int fd ) {
   return r; 
 }
 
+int sync() {
+  int r;
+
+  asm volatile( "svc #23    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : 
+              : "r0"            );
+
+  return r; 
+}
+
+int iostat( iostat_t *s ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "svc #24    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (s) 
+              : "r0"            );
+
+  return r; 
+}
+
+int umount() {
+  int r;
+
+  asm volatile( "svc #25    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : 
+              : "r0"            );
+
+  return r; 
+}
+
+int fstat( const char *path, stat_t *s ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "mov r1, %2 \n"
+                "svc #26    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (path), "r" (s) 
+              : "r0", "r1"      );
+
+  return r; 
+}
+
+int ftruncate( const int fd, uint32_t length ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "mov r1, %2 \n"
+                "svc #27    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (fd), "r" (length) 
+              : "r0", "r1"      );
+
+  return r; 
+}
+
+int fsendfile( const int out_fd, const int in_fd, uint32_t *offset, uint32_t count ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "mov r1, %2 \n"
+                "mov r2, %3 \n"
+                "mov r3, %4 \n"
+                "svc #29    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (out_fd), "r" (in_fd), "r" (offset), "r" (count) 
+              : "r0", "r1", "r2", "r3" );
+
+  return r; 
+}
+
+int freflink( const int out_fd, const int in_fd ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "mov r1, %2 \n"
+                "svc #34    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (out_fd), "r" (in_fd) 
+              : "r0", "r1"      );
+
+  return r; 
+}
+
 // ===========================
 // === DIRECTORY FUNCTIONS ===
 // ===========================
@@ -225,8 +425,42 @@ void pwd() {
   asm volatile( "svc #14 \n" );
 }
 
-void ls() {
-  asm volatile( "svc #15 \n" );
+int fgetdents( const char *path, uint32_t *cookie, dirent_t *d, int n ) {
+  int r;
+
+  asm volatile( "mov r0, %1 \n"
+                "mov r1, %2 \n"
+                "mov r2, %3 \n"
+                "mov r3, %4 \n"
+                "svc #28    \n"
+                "mov %0, r0 \n" 
+              : "=r" (r) 
+              : "r" (path), "r" (cookie), "r" (d), "r" (n) 
+              : "r0", "r1", "r2", "r3" );
+
+  return r; 
+}
+
+// a batch of entries at a time, each batch written out as one block of lines (directories marked by a trailing /)
+int ls( const char *path ) {
+  dirent_t d[ LS_BATCH ];
+  char     out[ LS_BATCH * ( sizeof( d[ 0 ].d_name ) + 1 ) ];
+  uint32_t cookie = 0;
+  int      n;
+
+  while ((n = fgetdents( path, &cookie, d, LS_BATCH )) > 0) {
+    int len = 0;
+
+    for (int i = 0; i < n; i++) {
+      memcpy( out + len, d[ i ].d_name, d[ i ].d_namlen ); len += d[ i ].d_namlen;
+      if (d[ i ].d_mode == DT_DIR) out[ len++ ] = '/';
+      out[ len++ ] = '\n';
+    }
+
+    write( STDIO, out, len );
+  }
+
+  return n;
 }
 
 int mkdir( const char *name ) {
@@ -269,16 +503,30 @@ int mv( const char *src, const char *dest ) {
   return r;
 }
 
-int cp( const char *src, const char *dest ) {
-  int r;
+// a copy of src is written to dest (created if need be, truncated if not) by one sendfile, or
+// made to share its data blocks if reflink (falling back to sendfile if the kernel can't)
+int cp( const char *src, const char *dest, int reflink ) {
+  int in = fopen( src, O_EXIST );
+  if (in == -1) return -1;
 
-  asm volatile( "mov r0, %1 \n"
-                "mov r1, %2 \n"
-                "svc #20    \n" 
-                "mov %0, r0 \n"
-              : "=r" (r) 
-              : "r" (src), "r" (dest)
-              : "r0"                  );
+  int out = fopen( dest, O_CREAT );
+  if (out == -1) {
+    fclose( in );
+    return -1;
+  }
+
+  if (reflink && freflink( out, in ) == 0) {
+    fclose( out );
+    fclose( in );
+    return 0;
+  }
+
+  int r = ftruncate( out, 0 );
+  if (r != -1 && fsendfile( out, in, NULL, SEND_ALL ) == -1)
+    r = -1;
+
+  fclose( out );
+  fclose( in );
 
   return r;
 }
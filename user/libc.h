@@ -3,9 +3,13 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "terms.h"
 
+#define LS_BATCH 16 // directory entries ls fetches per getdents call
+#define SEND_ALL 0xFFFFFFFF // fsendfile count that sends the rest of the file
+
 // cooperatively yield control of processor, i.e., invoke the scheduler
 void yield();
 
@@ -27,14 +31,26 @@ void craise( sig_t sig );
 int mqinit( int name ); // need to add mqd to processes list of open mqueues
 int mqunlink( int mqd );
 void msgsend( int mqd, const void* buf, size_t size );
-void msgreceive( int mqd, const void* buf, size_t size );
+int msgreceive( int mqd, const void* buf, size_t size ); // number of bytes received (a whole number of completions, see aio_read)
 
 // write n bytes from x to the file descriptor fd
 int write( int fd, void* x, size_t n );
 int read( int fd, void* x, size_t n );
+// read / write n bytes at offset in the file open as fd, leaving its head where it is
+int pread( int fd, void* x, size_t n, uint32_t offset );
+int pwrite( int fd, void* x, size_t n, uint32_t offset );
+// read / write cnt segments, each at its own offset, in one syscall (segments in the same block share its read)
+int readv( int fd, const iovec_t* iov, int cnt );
+int writev( int fd, const iovec_t* iov, int cnt );
+// queue a read / write of cb->aio_nbytes at cb->aio_offset (or, for fsync, a sync once those queued before it are done),
+// returning at once; its completion (aiocomp_t) is later posted to message queue cb->aio_mqd, where one msgreceive
+// collects as many as its buffer holds. cb can be reused once the call returns, the buffer only once it's complete
+int aio_read( const aiocb_t* cb );
+int aio_write( const aiocb_t* cb );
+int aio_fsync( const aiocb_t* cb );
 
 // filesystem functions
-void disk_wipe();
+void disk_wipe( falloc_t alloc );
 int fopen( const char *path, int ofile );
 int fclose( const int fd );
 int fseek( const int fd, uint32_t offset, const int whence );
@@ -42,16 +58,36 @@ int funlink( const char *name );
 
 int ftell( const int fd );
 
+// write back every dirty block the kernel has cached
+int sync();
+// fetch the kernel's I/O counters
+int iostat( iostat_t *s );
+// write back everything, marking the filesystem as cleanly unmounted
+int umount();
+// fetch the status of the file at path
+int fstat( const char *path, stat_t *s );
+// resize the file open as fd to length bytes (zero filled if it grows)
+int ftruncate( const int fd, uint32_t length );
+// copy count bytes (SEND_ALL: up to the end) of the file open as in_fd, from *offset (or its head if NULL),
+// to STDIO or the file open as out_fd, within the kernel; the number of bytes sent
+int fsendfile( const int out_fd, const int in_fd, uint32_t *offset, uint32_t count );
+// make the file open as out_fd a copy of that open as in_fd sharing its data blocks, each copied only once either is
+// written to (only inline and extent mapped files); 0 on success, -1 on failure
+int freflink( const int out_fd, const int in_fd );
+
 // ===========================
 // === DIRECTORY FUNCTIONS ===
 // ===========================
 
 void pwd();
-void ls();
+// list up to n entries of the directory at path into d, resuming from *cookie (0 to start); 0 once all are listed
+int fgetdents( const char *path, uint32_t *cookie, dirent_t *d, int n );
+// write the names in the directory at path to STDIO
+int ls( const char *path );
 int mkdir( const char *name );
 int cd( const char *path );
 int mv( const char *src, const char *dest );
-int cp( const char *src, const char *dest );
+int cp( const char *src, const char *dest, int reflink );
 
 // =========================
 // === HELPFUL FUNCTIONS ===